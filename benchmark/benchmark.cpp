@@ -1,8 +1,1901 @@
 ﻿#define _CRT_SECURE_NO_WARNINGS
 
-#include <ubench/ubench.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
+#if defined(__linux__)
+#    include <linux/futex.h>
+#    include <linux/perf_event.h>
+#    include <pthread.h>
+#    include <sched.h>
+#    include <sys/ioctl.h>
+#    include <sys/syscall.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif
 
-int main() {
+#include <hydra/activity.hpp>
+#include <hydra/activity_pool.hpp>
+#include <hydra/broadcast_queue.hpp>
+#include <hydra/byte_queue.hpp>
+#include <hydra/futex_event.hpp>
+#if defined(__linux__)
+#    include <hydra/journal_queue.hpp>
+#endif
+#include <hydra/mpmc_queue.hpp>
+#include <hydra/mpsc_queue.hpp>
+#include <hydra/pipeline.hpp>
+#if defined(__linux__)
+#    include <hydra/shared_queue.hpp>
+#endif
+#include <hydra/slot_storage.hpp>
+#include <hydra/spsc_queue.hpp>
+#include <hydra/stealing_activity.hpp>
+#include <hydra/unbounded_mpsc_queue.hpp>
+#include <hydra/wait_strategy.hpp>
+#include <usync/usync.hpp>
+
+#include "histogram.hpp"
+#include "ubench.hpp"
+
+
+namespace {
+
+
+    std::int64_t messages_count = 1 << 24;
+    constexpr std::int64_t queue_capacity = 1 << 10;
+    constexpr unsigned producer_core = 0;
+    constexpr unsigned consumer_core = 1;
+    constexpr std::int64_t paced_messages_count = 10000;
+    constexpr auto pacing_interval = std::chrono::microseconds {20};
+    constexpr unsigned blocked_producers_count = 16;
+
+
+    void pin_to_core(std::thread& thread, unsigned core) noexcept {
+#if defined(__linux__)
+        auto const cores = std::thread::hardware_concurrency();
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cores != 0 ? core % cores : core, &set);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+        (void)thread;
+        (void)core;
+#endif
+    }
+
+
+    // Counts hardware cache misses of the calling thread
+    // and threads started after the counter
+    class cache_misses_counter {
+#if defined(__linux__)
+        int fd_ {-1};
+#endif
+
+    public:
+        cache_misses_counter() noexcept {
+#if defined(__linux__)
+            perf_event_attr attr {};
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd_ = int(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if(fd_ != -1) {
+                ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+
+        cache_misses_counter(cache_misses_counter const&) = delete;
+        cache_misses_counter& operator=(cache_misses_counter const&) = delete;
+
+
+        ~cache_misses_counter() {
+#if defined(__linux__)
+            if(fd_ != -1)
+                close(fd_);
+#endif
+        }
+
+
+        // Returns -1 when counters are not available
+        std::int64_t stop() noexcept {
+#if defined(__linux__)
+            if(fd_ == -1)
+                return -1;
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            std::int64_t value = 0;
+            if(read(fd_, &value, sizeof(value)) != sizeof(value))
+                return -1;
+            return value;
+#else
+            return -1;
+#endif
+        }
+    };   // cache_misses_counter
+
+
+    struct stream_result {
+        double throughput;     // millions of messages per second
+        double cache_misses;   // per message, negative if not available
+    };
+
+
+    // Baseline for cursor caching: the producer reads the consumer
+    // cursor on every claim and the consumer reads a stamp on every
+    // fetch, as spsc_queue did before it cached them
+    template<typename T>
+    class uncached_spsc_queue {
+        using sequence_value = hydra::sequence::value_type;
+
+        alignas(hydra::cacheline_size) sequence_value capacity_ {0};
+        sequence_value index_mask_ {0};
+        std::unique_ptr<T[]> pool_;
+        std::unique_ptr<std::atomic<sequence_value>[]> published_;
+        alignas(hydra::cacheline_size)
+            std::atomic<sequence_value> producer_ {0};
+        alignas(hydra::cacheline_size)
+            std::atomic<sequence_value> consumer_ {0};
+
+    public:
+        void reserve(sequence_value capacity) {
+            published_ =
+                std::make_unique<std::atomic<sequence_value>[]>(
+                    std::size_t(capacity));
+            pool_ = std::make_unique<T[]>(std::size_t(capacity));
+            capacity_ = capacity;
+            index_mask_ = capacity - 1;
+        }
+
+
+        T& operator[](hydra::sequence n) noexcept {
+            return pool_[std::size_t(n.value() & index_mask_)];
+        }
+
+
+        hydra::sequence claim() noexcept {
+            auto const p = producer_.load(std::memory_order_relaxed);
+            producer_.store(p + 1, std::memory_order_relaxed);
+            while(p - consumer_.load(std::memory_order_acquire) >= capacity_)
+                std::this_thread::yield();
+            return hydra::sequence {p};
+        }
+
+
+        void publish(hydra::sequence n) noexcept {
+            published_[std::size_t(n.value() & index_mask_)].store(
+                n.value() + 1,
+                std::memory_order_release);
+        }
+
+
+        hydra::sequence try_fetch() noexcept {
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            if(published_[std::size_t(c & index_mask_)].load(
+                   std::memory_order_acquire)
+               != c + 1)
+                return hydra::sequence {};
+            return hydra::sequence {c};
+        }
+
+
+        void fetched() noexcept {
+            consumer_.store(consumer_.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_release);
+        }
+    };   // uncached_spsc_queue
+
+
+    // Streams messages from producer core to consumer core
+    template<typename Q>
+    stream_result ping_pong_throughput() {
+        Q queue;
+        queue.reserve(queue_capacity);
+        cache_misses_counter counter;
+
+        auto consumer = std::thread {[&queue] {
+            std::int64_t sum = 0;
+            for(std::int64_t i = 0; i != messages_count;) {
+                auto const n = queue.try_fetch();
+                if(!n)
+                    continue;
+                sum += queue[n];
+                queue.fetched();
+                ++i;
+            }
+            if(sum != messages_count * (messages_count - 1) / 2)
+                std::fprintf(stderr, "Invalid sum of messages\n");
+        }};
+        pin_to_core(consumer, consumer_core);
+
+        auto producer = std::thread {[&queue] {
+            for(std::int64_t i = 0; i != messages_count; ++i) {
+                auto const n = queue.claim();
+                queue[n] = i;
+                queue.publish(n);
+            }
+        }};
+        pin_to_core(producer, producer_core);
+
+        auto const started = std::chrono::steady_clock::now();
+        producer.join();
+        consumer.join();
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        auto const misses = counter.stop();
+
+        return {double(messages_count) / elapsed.count(),
+                double(misses) / double(messages_count)};
+    }
+
+
+    void print(char const* name, stream_result const& result) {
+        if(result.cache_misses < 0.)
+            std::printf("%-36s %6.1f M/s\n", name, result.throughput);
+        else
+            std::printf("%-36s %6.1f M/s %6.2f cache misses/msg\n",
+                        name,
+                        result.throughput,
+                        result.cache_misses);
+    }
+
+
+    template<template<typename, std::size_t> class Q>
+    void benchmark_layouts(char const* name) {
+        using namespace hydra;
+        char text[64];
+        std::snprintf(text, sizeof(text), "%s<packed_layout>:", name);
+        print(text, ping_pong_throughput<Q<std::int64_t, packed_layout>>());
+        std::snprintf(text, sizeof(text), "%s<cacheline_size>:", name);
+        print(text, ping_pong_throughput<Q<std::int64_t, cacheline_size>>());
+        std::snprintf(text, sizeof(text), "%s<cacheline_pair_size>:", name);
+        print(text,
+              ping_pong_throughput<Q<std::int64_t, cacheline_pair_size>>());
+    }
+
+
+
+#if defined(__linux__)
+    // Futex word of its own that wakes unconditionally, as
+    // futex_event::notify_one did before waiters were counted
+    class unconditional_event {
+        std::atomic_uint32_t value_ {0};
+        std::uint64_t syscalls_count_ {0};
+
+    public:
+        std::uint32_t value() const noexcept {
+            return value_.load(std::memory_order_acquire);
+        }
+
+
+        std::uint64_t syscalls_count() const noexcept {
+            return syscalls_count_;
+        }
+
+
+        void notify_one() noexcept {
+            value_.fetch_add(1, std::memory_order_release);
+            syscall(SYS_futex,
+                    &value_,
+                    FUTEX_WAKE_PRIVATE,
+                    1,
+                    nullptr,
+                    nullptr,
+                    0);
+            ++syscalls_count_;
+        }
+
+
+        void wait(std::uint32_t notified) noexcept {
+            syscall(SYS_futex,
+                    &value_,
+                    FUTEX_WAIT_PRIVATE,
+                    notified,
+                    nullptr,
+                    nullptr,
+                    0);
+        }
+    };   // unconditional_event
+#endif
+
+
+    // Consumer drains a counter and sleeps only when it's exhausted,
+    // like activity worker does; returns ns per notification
+    template<typename E, typename F>
+    double notification_latency(E& event, F&& notify) {
+        std::atomic<std::int64_t> produced {0};
+
+        auto consumer = std::thread {[&] {
+            std::int64_t seen = 0;
+            while(seen != messages_count) {
+                auto const notified = event.value();
+                auto const current = produced.load(std::memory_order_acquire);
+                if(current != seen) {
+                    seen = current;
+                    continue;
+                }
+                event.wait(notified);
+            }
+        }};
+        pin_to_core(consumer, consumer_core);
+
+        auto const started = std::chrono::steady_clock::now();
+        for(std::int64_t i = 0; i != messages_count; ++i) {
+            produced.fetch_add(1, std::memory_order_release);
+            notify();
+        }
+        auto const elapsed = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - started);
+        consumer.join();
+
+        return elapsed.count() / double(messages_count);
+    }
+
+
+    void benchmark_notifications() {
+        hydra::futex_event event;
+        auto const conditional = notification_latency(event, [&event] {
+            event.notify_one();
+        });
+        std::printf("futex_event::notify_one:             %6.1f ns/msg "
+                    "%6.3f syscalls/msg\n",
+                    conditional,
+                    double(event.syscalls_count()) / double(messages_count));
+
+#if defined(__linux__)
+        unconditional_event baseline;
+        auto const unconditional =
+            notification_latency(baseline, [&baseline] {
+                baseline.notify_one();
+            });
+        std::printf("unconditional FUTEX_WAKE:            %6.1f ns/msg "
+                    "%6.3f syscalls/msg\n",
+                    unconditional,
+                    double(baseline.syscalls_count())
+                        / double(messages_count));
+#endif
+    }
+
+
+
+    // Publishes timestamps to an idle-most-of-the-time activity,
+    // reports publish to handler latency and process CPU usage
+    template<typename W>
+    void benchmark_wait_strategy(char const* name) {
+        using clock = std::chrono::steady_clock;
+        using message = clock::time_point;
+
+        std::atomic<std::int64_t> latency_sum {0};
+        std::atomic<std::int64_t> latency_max {0};
+        std::atomic<std::int64_t> received {0};
+        hydra::activity<message, hydra::mpsc_queue<message>, W> activity;
+        activity.reserve(queue_capacity);
+        activity.run([&](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                auto const latency =
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        clock::now() - batch[n])
+                        .count();
+                latency_sum.fetch_add(latency, std::memory_order_relaxed);
+                if(latency > latency_max.load(std::memory_order_relaxed))
+                    latency_max.store(latency, std::memory_order_relaxed);
+                received.fetch_add(1, std::memory_order_relaxed);
+                batch.fetched();
+            }
+        });
+
+        auto const cpu_started = std::clock();
+        auto const started = clock::now();
+        auto next = started;
+        for(std::int64_t i = 0; i != paced_messages_count; ++i) {
+            next += pacing_interval;
+            while(clock::now() < next)
+                std::this_thread::sleep_until(next);
+            auto const n = activity.claim();
+            activity[n] = clock::now();
+            activity.publish(n);
+        }
+        while(received.load() != paced_messages_count)
+            std::this_thread::yield();
+        activity.stop();
+
+        auto const wall = std::chrono::duration<double>(clock::now() - started);
+        auto const cpu = double(std::clock() - cpu_started) / CLOCKS_PER_SEC;
+        std::printf("activity<%-14s %8.0f ns mean %8.0f ns max %6.1f%% CPU\n",
+                    name,
+                    double(latency_sum.load()) / double(paced_messages_count),
+                    double(latency_max.load()),
+                    100. * cpu / wall.count());
+    }
+
+
+    void benchmark_wait_strategies() {
+        benchmark_wait_strategy<hydra::busy_spin_wait>("busy_spin_wait>:");
+        benchmark_wait_strategy<hydra::yielding_wait>("yielding_wait>:");
+        benchmark_wait_strategy<hydra::sleeping_wait>("sleeping_wait>:");
+        benchmark_wait_strategy<hydra::blocking_wait>("blocking_wait>:");
+        benchmark_wait_strategy<hydra::adaptive_wait>("adaptive_wait>:");
+    }
+
+
+
+    // Many producers stuck behind a slow consumer
+    template<typename W>
+    void benchmark_back_pressure(char const* name,
+                                 std::int64_t release_threshold) {
+        using clock = std::chrono::steady_clock;
+        auto const per_producer =
+            paced_messages_count / blocked_producers_count;
+
+        hydra::mpsc_queue<std::int64_t> queue;
+        queue.reserve(64);
+        queue.park_producers(release_threshold);
+
+        auto const cpu_started = std::clock();
+        auto const started = clock::now();
+
+        std::vector<std::thread> producers;
+        for(unsigned i = 0; i != blocked_producers_count; ++i)
+            producers.emplace_back([&queue, per_producer] {
+                for(std::int64_t j = 0; j != per_producer; ++j) {
+                    auto const n = queue.claim(W {});
+                    queue[n] = j;
+                    queue.publish(n);
+                }
+            });
+
+        // Consumer is slowed down by a sleep per batch
+        for(std::int64_t i = 0; i != per_producer * blocked_producers_count;) {
+            auto const messages = queue.fetch_available(16);
+            if(messages.empty()) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::this_thread::sleep_for(pacing_interval);
+            queue.fetched(std::int64_t(messages.size()));
+            i += std::int64_t(messages.size());
+        }
+
+        for(auto& producer: producers)
+            producer.join();
+
+        auto const wall = std::chrono::duration<double>(clock::now() - started);
+        auto const cpu = double(std::clock() - cpu_started) / CLOCKS_PER_SEC;
+        auto const blocked =
+            std::chrono::duration<double>(queue.blocked_time());
+        std::printf("%-36s %6.1f%% CPU %8.3f s blocked\n",
+                    name,
+                    100. * cpu / wall.count(),
+                    blocked.count());
+    }
+
+
+    void benchmark_back_pressures() {
+        benchmark_back_pressure<hydra::yielding_wait>(
+            "back pressure, yielding:", 0);
+        benchmark_back_pressure<hydra::blocking_wait>(
+            "back pressure, parking:", 16);
+    }
+
+
+
+    // Returns millions of messages per second
+    double mpmc_throughput(unsigned producers_count, unsigned consumers_count) {
+        hydra::mpmc_queue<std::int64_t> queue;
+        queue.reserve(queue_capacity);
+        auto const per_producer = messages_count / producers_count;
+        auto const total = per_producer * producers_count;
+        std::atomic<std::int64_t> consumed {0};
+
+        auto const started = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for(unsigned i = 0; i != consumers_count; ++i)
+            threads.emplace_back([&queue, &consumed, total] {
+                while(consumed.load(std::memory_order_relaxed) != total) {
+                    auto const messages = queue.fetch_available(16);
+                    if(messages.empty()) {
+                        hydra::cpu_relax();
+                        continue;
+                    }
+                    queue.fetched(messages.first,
+                                  std::int64_t(messages.size()));
+                    consumed.fetch_add(std::int64_t(messages.size()),
+                                       std::memory_order_relaxed);
+                }
+            });
+
+        for(unsigned i = 0; i != producers_count; ++i)
+            threads.emplace_back([&queue, per_producer] {
+                for(std::int64_t j = 0; j != per_producer; ++j) {
+                    auto const n = queue.claim();
+                    queue[n] = j;
+                    queue.publish(n);
+                }
+            });
+
+        for(unsigned i = 0; i != threads.size(); ++i)
+            pin_to_core(threads[i], i);
+        for(auto& thread: threads)
+            thread.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(total) / elapsed.count();
+    }
+
+
+    void benchmark_mpmc_scaling() {
+        std::printf("mpmc_queue, M/s  consumers:     1       2       4       8\n");
+        for(unsigned producers = 1; producers <= 32; producers *= 2) {
+            std::printf("%2u producers                ", producers);
+            for(unsigned consumers = 1; consumers <= 8; consumers *= 2)
+                std::printf("%8.1f", mpmc_throughput(producers, consumers));
+            std::printf("\n");
+        }
+    }
+
+
+
+    // Stands for risk checks or serialization
+    std::uint64_t heavy_handler_work(std::uint64_t x) noexcept {
+        for(int i = 0; i != 1000; ++i)
+            x = x * 6364136223846793005ull + 1442695040888963407ull;
+        return x;
+    }
+
+
+    // Returns millions of messages per second
+    double pool_throughput(unsigned workers_count) {
+        auto const total = messages_count / 16;
+        std::atomic<std::uint64_t> checksum {0};
+        hydra::activity_pool<std::uint64_t> pool;
+        pool.reserve(queue_capacity);
+        pool.run(
+            [&checksum](auto& batch) {
+                std::uint64_t sum = 0;
+                for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                    sum += heavy_handler_work(batch[n]);
+                    batch.fetched();
+                }
+                checksum.fetch_add(sum, std::memory_order_relaxed);
+            },
+            workers_count);
+
+        auto const started = std::chrono::steady_clock::now();
+        for(std::int64_t i = 0; i != total; ++i) {
+            auto const n = pool.claim();
+            pool[n] = std::uint64_t(i);
+            pool.publish(n);
+        }
+        pool.stop();
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+
+        return double(total) / elapsed.count();
+    }
+
+
+    void benchmark_pool_scaling() {
+        auto const cores = (std::max)(std::thread::hardware_concurrency(), 1u);
+        for(unsigned workers = 1; workers <= cores; workers *= 2)
+            std::printf("activity_pool, %2u workers:           %6.2f M/s\n",
+                        workers,
+                        pool_throughput(workers));
+    }
+
+
+
+    constexpr std::size_t skewed_shards = 4;
+
+
+    std::int64_t now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+
+    // Nine of ten messages go to the first shard
+    std::size_t skewed_shard(std::int64_t i) noexcept {
+        return i % 10 != 0 ? 0 : 1 + std::size_t(i / 10) % (skewed_shards - 1);
+    }
+
+
+    struct latencies {
+        std::vector<std::int64_t> samples;
+
+        void print(char const* name) {
+            std::sort(samples.begin(), samples.end());
+            auto const at = [this](double q) {
+                return samples[std::size_t(q * double(samples.size() - 1))];
+            };
+            std::printf("%-28s p50 %9lld ns, p99 %9lld ns\n",
+                        name,
+                        (long long)at(0.5),
+                        (long long)at(0.99));
+        }
+    };   // latencies
+
+
+    // Each worker records latencies of the messages it handled
+    template<typename Batch>
+    void record_latencies(Batch& batch, std::vector<std::int64_t>& samples) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            heavy_handler_work(std::uint64_t(batch[n]));
+            samples.push_back(now_ns() - batch[n]);
+            batch.fetched();
+        }
+    }
+
+
+    latencies separate_latencies(std::int64_t total) {
+        std::vector<std::int64_t> samples[skewed_shards];
+        auto shards = std::make_unique<
+            hydra::activity<std::int64_t, hydra::mpmc_queue<std::int64_t>>[]>(
+            skewed_shards);
+        for(std::size_t i = 0; i != skewed_shards; ++i) {
+            shards[i].reserve(queue_capacity);
+            samples[i].reserve(std::size_t(total));
+            shards[i].run([&samples, i](auto& batch) {
+                record_latencies(batch, samples[i]);
+            });
+        }
+
+        for(std::int64_t i = 0; i != total; ++i) {
+            auto& shard = shards[skewed_shard(i)];
+            auto const n = shard.claim();
+            shard[n] = now_ns();
+            shard.publish(n);
+        }
+
+        latencies result;
+        for(std::size_t i = 0; i != skewed_shards; ++i) {
+            shards[i].stop();
+            result.samples.insert(result.samples.end(),
+                                  samples[i].begin(),
+                                  samples[i].end());
+        }
+        return result;
+    }
+
+
+    latencies stealing_latencies(std::int64_t total) {
+        std::vector<std::int64_t> samples[skewed_shards];
+        hydra::stealing_activity<std::int64_t> activity {skewed_shards};
+        activity.reserve(queue_capacity);
+        for(auto& worker_samples: samples)
+            worker_samples.reserve(std::size_t(total));
+        std::atomic<std::size_t> workers_count {0};
+        activity.run([&samples, &workers_count](auto& batch) {
+            thread_local std::size_t const worker = workers_count++;
+            record_latencies(batch, samples[worker]);
+        });
+
+        for(std::int64_t i = 0; i != total; ++i) {
+            auto& shard = activity.shard(skewed_shard(i));
+            auto const n = shard.claim();
+            shard[n] = now_ns();
+            shard.publish(n);
+        }
+        activity.stop();
+
+        latencies result;
+        for(auto const& worker_samples: samples)
+            result.samples.insert(result.samples.end(),
+                                  worker_samples.begin(),
+                                  worker_samples.end());
+        return result;
+    }
+
+
+    void benchmark_skewed_load() {
+        auto const total = messages_count / 16;
+        separate_latencies(total).print("skewed, separate activities");
+        stealing_latencies(total).print("skewed, stealing_activity");
+    }
+
+
+
+    constexpr unsigned feed_consumers = 3;
+
+
+    // Stands for a market data update
+    struct quote {
+        std::int64_t instrument;
+        std::int64_t bid_price;
+        std::int64_t ask_price;
+        std::int64_t bid_size;
+        std::int64_t ask_size;
+        std::int64_t exchange_time;
+        std::int64_t receive_time;
+        std::int64_t sequence_number;
+    };   // quote
+
+
+    quote make_quote(std::int64_t i) noexcept {
+        return quote {i & 63, i, i + 1, 100, 200, i, i, i};
+    }
+
+
+    // Returns millions of messages per second seen by every consumer
+    double broadcast_throughput() {
+        hydra::broadcast_queue<quote> queue;
+        queue.reserve(queue_capacity);
+        std::vector<hydra::broadcast_queue<quote>::consumer*> consumers;
+        for(unsigned i = 0; i != feed_consumers; ++i)
+            consumers.push_back(&queue.subscribe());
+        std::atomic<std::int64_t> checksum {0};
+
+        auto const started = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for(auto* each: consumers)
+            threads.emplace_back([each, &checksum] {
+                std::int64_t sum = 0;
+                for(std::int64_t received = 0; received != messages_count;) {
+                    auto const messages = each->fetch_available(16);
+                    if(messages.empty()) {
+                        hydra::cpu_relax();
+                        continue;
+                    }
+                    for(std::size_t i = 0; i != messages.size(); ++i)
+                        sum += messages[i].bid_price;
+                    each->fetched(std::int64_t(messages.size()));
+                    received += std::int64_t(messages.size());
+                }
+                checksum.fetch_add(sum, std::memory_order_relaxed);
+            });
+
+        threads.emplace_back([&queue] {
+            for(std::int64_t i = 0; i != messages_count; ++i) {
+                auto const n = queue.claim();
+                queue[n] = make_quote(i);
+                queue.publish(n);
+            }
+        });
+
+        for(unsigned i = 0; i != threads.size(); ++i)
+            pin_to_core(threads[i], i);
+        for(auto& thread: threads)
+            thread.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    // The same feed copied by the producer into a queue per consumer
+    double copied_feed_throughput() {
+        std::vector<hydra::mpsc_queue<quote>> queues(feed_consumers);
+        for(auto& queue: queues)
+            queue.reserve(queue_capacity);
+        std::atomic<std::int64_t> checksum {0};
+
+        auto const started = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for(auto& queue: queues)
+            threads.emplace_back([&queue, &checksum] {
+                std::int64_t sum = 0;
+                for(std::int64_t received = 0; received != messages_count;) {
+                    auto const messages = queue.fetch_available(16);
+                    if(messages.empty()) {
+                        hydra::cpu_relax();
+                        continue;
+                    }
+                    for(std::size_t i = 0; i != messages.size(); ++i)
+                        sum += messages[i].bid_price;
+                    queue.fetched(std::int64_t(messages.size()));
+                    received += std::int64_t(messages.size());
+                }
+                checksum.fetch_add(sum, std::memory_order_relaxed);
+            });
+
+        threads.emplace_back([&queues] {
+            for(std::int64_t i = 0; i != messages_count; ++i) {
+                auto const update = make_quote(i);
+                for(auto& queue: queues) {
+                    auto const n = queue.claim();
+                    queue[n] = update;
+                    queue.publish(n);
+                }
+            }
+        });
+
+        for(unsigned i = 0; i != threads.size(); ++i)
+            pin_to_core(threads[i], i);
+        for(auto& thread: threads)
+            thread.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    void benchmark_broadcast() {
+        std::printf("feed to %u consumers, broadcast_queue:  %6.2f M/s\n",
+                    feed_consumers,
+                    broadcast_throughput());
+        std::printf("feed to %u consumers, mpsc_queue copies: %6.2f M/s\n",
+                    feed_consumers,
+                    copied_feed_throughput());
+    }
+
+
+
+    // Returns millions of messages per second passed
+    // through decode, enrich and persist stages
+    double pipeline_throughput() {
+        std::atomic<std::int64_t> checksum {0};
+        hydra::pipeline<quote> stages;
+        stages.reserve(queue_capacity);
+        auto const decode = stages.add_stage([](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                batch[n].bid_price = batch[n].instrument * 100;
+                batch.fetched();
+            }
+        });
+        auto const enrich = stages.add_stage(
+            [](auto& batch) {
+                for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                    batch[n].ask_price = batch[n].bid_price + 1;
+                    batch.fetched();
+                }
+            },
+            {decode});
+        stages.add_stage(
+            [&checksum](auto& batch) {
+                std::int64_t sum = 0;
+                for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                    sum += batch[n].ask_price;
+                    batch.fetched();
+                }
+                checksum.fetch_add(sum, std::memory_order_relaxed);
+            },
+            {enrich});
+        stages.run();
+
+        auto const started = std::chrono::steady_clock::now();
+        for(std::int64_t i = 0; i != messages_count; ++i) {
+            auto const n = stages.claim();
+            stages[n] = make_quote(i);
+            stages.publish(n);
+        }
+        stages.stop();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    // The same stages as activities copying messages to the next one
+    double chained_activities_throughput() {
+        std::atomic<std::int64_t> checksum {0};
+        hydra::activity<quote> persist;
+        hydra::activity<quote> enrich;
+        hydra::activity<quote> decode;
+        for(auto* each: {&persist, &enrich, &decode})
+            each->reserve(queue_capacity);
+
+        persist.run([&checksum](auto& batch) {
+            std::int64_t sum = 0;
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                sum += batch[n].ask_price;
+                batch.fetched();
+            }
+            checksum.fetch_add(sum, std::memory_order_relaxed);
+        });
+        enrich.run([&persist](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                auto const next = persist.claim();
+                persist[next] = batch[n];
+                persist[next].ask_price = batch[n].bid_price + 1;
+                persist.publish(next);
+                batch.fetched();
+            }
+        });
+        decode.run([&enrich](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                auto const next = enrich.claim();
+                enrich[next] = batch[n];
+                enrich[next].bid_price = batch[n].instrument * 100;
+                enrich.publish(next);
+                batch.fetched();
+            }
+        });
+
+        auto const started = std::chrono::steady_clock::now();
+        for(std::int64_t i = 0; i != messages_count; ++i) {
+            auto const n = decode.claim();
+            decode[n] = make_quote(i);
+            decode.publish(n);
+        }
+        decode.stop();
+        enrich.stop();
+        persist.stop();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    void benchmark_pipeline() {
+        std::printf("3 stages, pipeline:                  %6.2f M/s\n",
+                    pipeline_throughput());
+        std::printf("3 stages, chained activities:        %6.2f M/s\n",
+                    chained_activities_throughput());
+    }
+
+
+
+    // Returns millions of messages per second from several producers
+    // and time producers spent claiming
+    template<typename Q>
+    std::pair<double, double> producers_throughput(unsigned producers_count) {
+        Q queue;
+        queue.reserve(queue_capacity);
+        auto const per_producer = messages_count / producers_count;
+        auto const total = per_producer * producers_count;
+        std::atomic<std::int64_t> claiming_ns {0};
+
+        auto const started = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        threads.emplace_back([&queue, total] {
+            for(std::int64_t consumed = 0; consumed != total;) {
+                auto const messages = queue.fetch_available(16);
+                if(messages.empty()) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                queue.fetched(std::int64_t(messages.size()));
+                consumed += std::int64_t(messages.size());
+            }
+        });
+
+        for(unsigned i = 0; i != producers_count; ++i)
+            threads.emplace_back([&queue, &claiming_ns, per_producer] {
+                std::chrono::steady_clock::duration claiming {};
+                for(std::int64_t j = 0; j != per_producer; ++j) {
+                    auto const before = std::chrono::steady_clock::now();
+                    auto const n = queue.claim();
+                    claiming += std::chrono::steady_clock::now() - before;
+                    queue[n] = j;
+                    queue.publish(n);
+                }
+                claiming_ns.fetch_add(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        claiming)
+                        .count());
+            });
+
+        for(unsigned i = 0; i != threads.size(); ++i)
+            pin_to_core(threads[i], i);
+        for(auto& thread: threads)
+            thread.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return {double(total) / elapsed.count(),
+                double(claiming_ns.load()) / double(total)};
+    }
+
+
+    void benchmark_unbounded() {
+        for(unsigned producers = 1; producers <= 4; producers *= 2) {
+            auto const [bounded, bounded_claim] =
+                producers_throughput<hydra::mpsc_queue<std::int64_t>>(
+                    producers);
+            auto const [unbounded, unbounded_claim] = producers_throughput<
+                hydra::unbounded_mpsc_queue<std::int64_t>>(producers);
+            std::printf("%u producers, mpsc_queue:           %6.2f M/s, "
+                        "claim %6.1f ns\n",
+                        producers,
+                        bounded,
+                        bounded_claim);
+            std::printf("%u producers, unbounded_mpsc_queue: %6.2f M/s, "
+                        "claim %6.1f ns\n",
+                        producers,
+                        unbounded,
+                        unbounded_claim);
+        }
+    }
+
+
+
+    // Consumer grows and shrinks the queue while a producer writes,
+    // prints resize pauses and the worst claim
+    void benchmark_resize() {
+        hydra::mpsc_queue<std::int64_t> queue;
+        queue.reserve(queue_capacity);
+        auto const total = messages_count;
+        std::int64_t worst_claim_ns = 0;
+
+        std::thread producer {[&queue, &worst_claim_ns, total] {
+            for(std::int64_t i = 0; i != total; ++i) {
+                auto const before = std::chrono::steady_clock::now();
+                auto const n = queue.claim();
+                auto const claiming = std::chrono::duration_cast<
+                    std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - before);
+                worst_claim_ns = (std::max)(worst_claim_ns, claiming.count());
+                queue[n] = i;
+                queue.publish(n);
+            }
+        }};
+
+        for(std::int64_t consumed = 0, batches = 0; consumed != total;) {
+            auto const messages = queue.fetch_available(16);
+            if(messages.empty()) {
+                hydra::cpu_relax();
+                continue;
+            }
+            queue.fetched(std::int64_t(messages.size()));
+            consumed += std::int64_t(messages.size());
+            if(++batches % 1000 == 0)
+                queue.resize(batches % 2000 == 0 ? queue_capacity
+                                                 : 4 * queue_capacity);
+        }
+        producer.join();
+
+        auto const resizes = (std::max)(queue.resizes_count(),
+                                        std::int64_t(1));
+        std::printf("mpsc_queue, %lld resizes:  average pause %8.1f ns, "
+                    "worst claim %lld ns\n",
+                    (long long)queue.resizes_count(),
+                    double(queue.resize_time().count()) / double(resizes),
+                    (long long)worst_claim_ns);
+    }
+
+
+
+    constexpr char const* text_message =
+        "8=FIX.4.4|35=D|55=EURUSD|54=1|38=1000000|44=1.08125|40=2|";
+
+
+    // Returns millions of text messages per second through std::string slots
+    double string_slots_throughput() {
+        hydra::mpsc_queue<std::string> queue;
+        queue.reserve(queue_capacity);
+        std::size_t received_bytes = 0;
+
+        auto const started = std::chrono::steady_clock::now();
+        std::thread consumer {[&queue, &received_bytes] {
+            for(std::int64_t consumed = 0; consumed != messages_count;) {
+                auto const n = queue.try_fetch();
+                if(!n) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                received_bytes += queue[n].size();
+                queue[n] = std::string {};
+                queue.fetched();
+                ++consumed;
+            }
+        }};
+
+        for(std::int64_t i = 0; i != messages_count; ++i) {
+            auto const n = queue.claim();
+            queue[n] = text_message;
+            queue.publish(n);
+        }
+        consumer.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    // The same messages written in place into byte_queue records
+    double byte_records_throughput() {
+        hydra::byte_queue<> queue;
+        queue.reserve(queue_capacity * 64);
+        std::size_t received_bytes = 0;
+        auto const length = std::strlen(text_message);
+
+        auto const started = std::chrono::steady_clock::now();
+        std::thread consumer {[&queue, &received_bytes] {
+            for(std::int64_t consumed = 0; consumed != messages_count;) {
+                auto const n = queue.try_fetch();
+                if(!n) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                received_bytes += queue[n].size();
+                queue.fetched();
+                ++consumed;
+            }
+        }};
+
+        for(std::int64_t i = 0; i != messages_count; ++i) {
+            auto const claimed = queue.claim(std::int64_t(length));
+            std::memcpy(claimed.bytes.data(), text_message, length);
+            queue.publish(claimed);
+        }
+        consumer.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    void benchmark_text_messages() {
+        std::printf("text, mpsc_queue<std::string>:       %6.2f M/s\n",
+                    string_slots_throughput());
+        std::printf("text, byte_queue records:            %6.2f M/s\n",
+                    byte_records_throughput());
+    }
+
+
+
+    // Returns millions of messages per second emplaced through spsc_queue
+    // with the given slot lifetime
+    template<typename T, hydra::slot_lifetime Lifetime, typename F>
+    double emplace_throughput(F&& make_argument) {
+        using storage = hydra::separate_slots<T, Lifetime>;
+        hydra::spsc_queue<T, hydra::cacheline_size, storage> queue;
+        queue.reserve(queue_capacity);
+
+        auto const started = std::chrono::steady_clock::now();
+        std::thread consumer {[&queue] {
+            for(std::int64_t consumed = 0; consumed != messages_count;) {
+                auto const messages = queue.fetch_available(16);
+                if(messages.empty()) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                queue.fetched(std::int64_t(messages.size()));
+                consumed += std::int64_t(messages.size());
+            }
+        }};
+
+        for(std::int64_t i = 0; i != messages_count; ++i)
+            queue.emplace(make_argument(i));
+        consumer.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    void benchmark_slot_lifetimes() {
+        using hydra::slot_lifetime;
+        auto const number = [](std::int64_t i) { return i; };
+        auto const text = [](std::int64_t) { return text_message; };
+        std::printf(
+            "int64, persistent slots:             %6.2f M/s\n",
+            emplace_throughput<std::int64_t, slot_lifetime::persistent>(
+                number));
+        std::printf(
+            "int64, per_message slots:            %6.2f M/s\n",
+            emplace_throughput<std::int64_t, slot_lifetime::per_message>(
+                number));
+        std::printf(
+            "std::string, persistent slots:       %6.2f M/s\n",
+            emplace_throughput<std::string, slot_lifetime::persistent>(text));
+        std::printf(
+            "std::string, per_message slots:      %6.2f M/s\n",
+            emplace_throughput<std::string, slot_lifetime::per_message>(text));
+    }
+
+
+    template<std::size_t N>
+    struct payload {
+        std::byte bytes[N];
+    };
+
+
+    // Messages per microsecond moved through spsc_queue either one message
+    // at a time or with push_bulk/try_pop_bulk in chunks of 64
+    template<std::size_t N>
+    double copy_throughput(bool bulk) {
+        constexpr std::int64_t chunk = 64;
+        hydra::spsc_queue<payload<N>> queue;
+        queue.reserve(queue_capacity);
+
+        auto const started = std::chrono::steady_clock::now();
+        std::thread consumer {[&queue, bulk] {
+            std::vector<payload<N>> out(chunk);
+            for(std::int64_t consumed = 0; consumed != messages_count;) {
+                if(bulk) {
+                    auto const count = queue.try_pop_bulk(out.data(), chunk);
+                    if(count == 0)
+                        hydra::cpu_relax();
+                    consumed += std::int64_t(count);
+                    continue;
+                }
+                auto const n = queue.try_fetch();
+                if(!n) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                out[0] = queue[n];
+                queue.fetched();
+                ++consumed;
+            }
+        }};
+
+        std::vector<payload<N>> in(chunk);
+        for(std::int64_t sent = 0; sent != messages_count;) {
+            auto const count = (std::min)(chunk, messages_count - sent);
+            if(bulk) {
+                queue.push_bulk(in.data(), count);
+            } else {
+                for(std::int64_t i = 0; i != count; ++i) {
+                    auto const n = queue.claim();
+                    queue[n] = in[i];
+                    queue.publish(n);
+                }
+            }
+            sent += count;
+        }
+        consumer.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(messages_count) / elapsed.count();
+    }
+
+
+    template<std::size_t N>
+    void benchmark_copy_size() {
+        std::printf("%3zu bytes, per message:              %6.2f M/s\n",
+                    N, copy_throughput<N>(false));
+        std::printf("%3zu bytes, push_bulk/try_pop_bulk:   %6.2f M/s\n",
+                    N, copy_throughput<N>(true));
+    }
+
+
+    void benchmark_bulk_copy() {
+        benchmark_copy_size<16>();
+        benchmark_copy_size<64>();
+        benchmark_copy_size<256>();
+    }
+
+
+    // Cache misses per message with stamps next to values or apart
+    void benchmark_slot_layouts() {
+        using namespace hydra;
+        using separate = separate_slots<std::int64_t>;
+        using interleaved = interleaved_slots<std::int64_t>;
+        print("spsc_queue<separate_slots>:",
+              ping_pong_throughput<
+                  spsc_queue<std::int64_t, cacheline_size, separate>>());
+        print("spsc_queue<interleaved_slots>:",
+              ping_pong_throughput<
+                  spsc_queue<std::int64_t, cacheline_size, interleaved>>());
+        print("mpsc_queue<separate_slots>:",
+              ping_pong_throughput<
+                  mpsc_queue<std::int64_t, cacheline_size, separate>>());
+        print("mpsc_queue<interleaved_slots>:",
+              ping_pong_throughput<
+                  mpsc_queue<std::int64_t, cacheline_size, interleaved>>());
+    }
+
+
+    struct ring_pass_result {
+        double reserve_ms;
+        double first_pass;    // millions of messages per second
+        double second_pass;
+    };
+
+
+    // Pushes messages through a freshly reserved ring of 64-byte
+    // messages twice, the first pass takes page faults unless prefaulted
+    ring_pass_result ring_pass(hydra::memory_options const& options) {
+        constexpr std::int64_t capacity = 1 << 18;
+        hydra::spsc_queue<payload<64>> queue;
+
+        auto const reserving = std::chrono::steady_clock::now();
+        queue.reserve(capacity, options);
+        auto const reserved = std::chrono::steady_clock::now();
+
+        auto const pass = [&queue] {
+            auto const started = std::chrono::steady_clock::now();
+            for(std::int64_t i = 0; i != capacity; ++i) {
+                auto const n = queue.claim();
+                queue[n].bytes[0] = std::byte(i);
+                queue.publish(n);
+            }
+            queue.fetched(std::int64_t(queue.fetch_available(capacity).size()));
+            auto const elapsed = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - started);
+            return double(capacity) / elapsed.count();
+        };
+
+        auto const first = pass();
+        return {std::chrono::duration<double, std::milli>(reserved - reserving)
+                    .count(),
+                first,
+                pass()};
+    }
+
+
+    void benchmark_ring_memory() {
+        using hydra::memory_options;
+        using hydra::page_size;
+        struct {
+            char const* name;
+            memory_options options;
+        } const cases[] = {
+            {"heap", memory_options {}},
+            {"mapped, prefault", memory_options {-1, page_size::regular, true}},
+            {"huge 2MB", memory_options {-1, page_size::huge_2mb, false}},
+            {"huge 2MB, prefault",
+             memory_options {-1, page_size::huge_2mb, true}},
+        };
+        for(auto const& each: cases) {
+            auto const result = ring_pass(each.options);
+            std::printf("%-20s reserve %7.2f ms, first pass %6.2f M/s, "
+                        "second pass %6.2f M/s\n",
+                        each.name,
+                        result.reserve_ms,
+                        result.first_pass,
+                        result.second_pass);
+        }
+    }
+
+
+#if defined(__linux__)
+
+    // Half of the round trip between two processes over a pair
+    // of shared queues, in nanoseconds
+    template<typename W>
+    double two_process_latency(W const& wait) {
+        using queue = hydra::shared_spsc_queue<std::int64_t>;
+        auto const round_trips = (std::min)(messages_count,
+                                            std::int64_t(100000));
+        auto ping = queue::create_anonymous(queue_capacity);
+        auto pong = queue::create_anonymous(queue_capacity);
+
+        auto const child = fork();
+        if(child == -1)
+            return -1.;
+        if(child == 0) {
+            auto requests = queue::attach(ping.fd());
+            auto responses = queue::attach(pong.fd());
+            for(std::int64_t i = 0; i != round_trips; ++i) {
+                auto const n = requests.fetch(wait);
+                auto const value = requests[n];
+                requests.fetched();
+                auto const m = responses.claim();
+                responses[m] = value;
+                responses.publish(m);
+            }
+            _exit(0);
+        }
+
+        auto const started = std::chrono::steady_clock::now();
+        for(std::int64_t i = 0; i != round_trips; ++i) {
+            auto const n = ping.claim();
+            ping[n] = i;
+            ping.publish(n);
+            auto const m = pong.fetch(wait);
+            if(pong[m] != i)
+                std::fprintf(stderr, "Invalid response\n");
+            pong.fetched();
+        }
+        auto const elapsed = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - started);
+        waitpid(child, nullptr, 0);
+        return elapsed.count() / double(round_trips) / 2.;
+    }
+
+
+    void benchmark_shared_queues() {
+        std::printf("two processes, yielding_wait:        %8.1f ns\n",
+                    two_process_latency(hydra::yielding_wait {}));
+        std::printf("two processes, blocking_wait:        %8.1f ns\n",
+                    two_process_latency(hydra::blocking_wait {}));
+    }
+
+#endif
+
+
+#if defined(__linux__)
+
+    // Messages per microsecond until all of them are on disk,
+    // zero period syncs each published batch
+    double journal_throughput(std::chrono::nanoseconds period) {
+        auto const directory =
+            std::filesystem::temp_directory_path()
+            / ("hydra-benchmark-" + std::to_string(getpid()));
+        std::filesystem::remove_all(directory);
+        auto const count = (std::min)(messages_count, std::int64_t(1 << 20));
+        double throughput = 0.;
+        {
+            hydra::journal_queue<quote> journal;
+            if(!journal.open(hydra::journal_options {directory, 1 << 16}))
+                return -1.;
+            journal.start_syncing(period);
+
+            auto const started = std::chrono::steady_clock::now();
+            for(std::int64_t i = 0; i != count; ++i) {
+                auto const n = journal.claim();
+                journal[n] = make_quote(i);
+                journal.publish(n);
+            }
+            while(journal.durable().value() != count)
+                std::this_thread::yield();
+            auto const elapsed = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - started);
+            throughput = double(count) / elapsed.count();
+        }
+        std::filesystem::remove_all(directory);
+        return throughput;
+    }
+
+
+    void benchmark_journal() {
+        using namespace std::chrono_literals;
+        std::printf("journal, msync each batch:           %6.2f M/s\n",
+                    journal_throughput(0ms));
+        std::printf("journal, msync every 1 ms:           %6.2f M/s\n",
+                    journal_throughput(1ms));
+        std::printf("journal, msync every 10 ms:          %6.2f M/s\n",
+                    journal_throughput(10ms));
+    }
+
+#endif
+
+
+
+    // Spins until the next send time, sleeping would add wakeup latency
+    // to the measurement
+    class pacer {
+    public:
+        pacer() noexcept : next_ {std::chrono::steady_clock::now()} {}
+
+        void wait() noexcept {
+            next_ += pacing_interval;
+            while(std::chrono::steady_clock::now() < next_)
+                hydra::cpu_relax();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point next_;
+    };   // pacer
+
+
+    // Paced messages carry their send time, the consumer records
+    // how long each one took to arrive
+    template<typename Q>
+    bench::latency_histogram one_way_latency() {
+        Q queue;
+        queue.reserve(queue_capacity);
+        bench::latency_histogram histogram;
+
+        auto consumer = std::thread {[&queue, &histogram] {
+            for(std::int64_t i = 0; i != paced_messages_count;) {
+                auto const n = queue.try_fetch();
+                if(!n) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                histogram.record(now_ns() - queue[n]);
+                queue.fetched();
+                ++i;
+            }
+        }};
+        pin_to_core(consumer, consumer_core);
+
+        auto producer = std::thread {[&queue] {
+            pacer pace;
+            for(std::int64_t i = 0; i != paced_messages_count; ++i) {
+                pace.wait();
+                auto const n = queue.claim();
+                queue[n] = now_ns();
+                queue.publish(n);
+            }
+        }};
+        pin_to_core(producer, producer_core);
+
+        producer.join();
+        consumer.join();
+        return histogram;
+    }
+
+
+    bench::latency_histogram activity_one_way_latency() {
+        bench::latency_histogram histogram;
+        std::atomic<std::int64_t> received {0};
+        hydra::activity<std::int64_t> activity;
+        activity.reserve(queue_capacity);
+        activity.run([&histogram, &received](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                histogram.record(now_ns() - batch[n]);
+                batch.fetched();
+                received.fetch_add(1, std::memory_order_release);
+            }
+        });
+
+        pacer pace;
+        for(std::int64_t i = 0; i != paced_messages_count; ++i) {
+            pace.wait();
+            auto const n = activity.claim();
+            activity[n] = now_ns();
+            activity.publish(n);
+        }
+        while(received.load(std::memory_order_acquire)
+              != paced_messages_count)
+            std::this_thread::yield();
+        activity.stop();
+        return histogram;
+    }
+
+
+    // A message goes to an echo thread and back before the next one
+    template<typename Q>
+    bench::latency_histogram round_trip_latency() {
+        Q requests;
+        Q responses;
+        requests.reserve(queue_capacity);
+        responses.reserve(queue_capacity);
+
+        auto echo = std::thread {[&requests, &responses] {
+            for(std::int64_t i = 0; i != paced_messages_count;) {
+                auto const n = requests.try_fetch();
+                if(!n) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                auto const m = responses.claim();
+                responses[m] = requests[n];
+                responses.publish(m);
+                requests.fetched();
+                ++i;
+            }
+        }};
+        pin_to_core(echo, consumer_core);
+
+        bench::latency_histogram histogram;
+        for(std::int64_t i = 0; i != paced_messages_count; ++i) {
+            auto const n = requests.claim();
+            requests[n] = now_ns();
+            requests.publish(n);
+            auto m = responses.try_fetch();
+            while(!m) {
+                hydra::cpu_relax();
+                m = responses.try_fetch();
+            }
+            histogram.record(now_ns() - responses[m]);
+            responses.fetched();
+        }
+        echo.join();
+        return histogram;
+    }
+
+
+    // Both sides park on futex_event between messages
+    bench::latency_histogram futex_round_trip_latency() {
+        hydra::futex_event ping;
+        hydra::futex_event pong;
+        std::atomic<std::int64_t> pinged {0};
+        std::atomic<std::int64_t> ponged {0};
+
+        auto echo = std::thread {[&] {
+            for(std::int64_t i = 1; i <= paced_messages_count; ++i) {
+                hydra::blocking_wait {}.wait_until(ping, [&pinged, i] {
+                    return pinged.load(std::memory_order_acquire) == i;
+                });
+                ponged.store(i, std::memory_order_release);
+                pong.notify_one();
+            }
+        }};
+        pin_to_core(echo, consumer_core);
+
+        bench::latency_histogram histogram;
+        for(std::int64_t i = 1; i <= paced_messages_count; ++i) {
+            auto const started = now_ns();
+            pinged.store(i, std::memory_order_release);
+            ping.notify_one();
+            hydra::blocking_wait {}.wait_until(pong, [&ponged, i] {
+                return ponged.load(std::memory_order_acquire) == i;
+            });
+            histogram.record(now_ns() - started);
+        }
+        echo.join();
+        return histogram;
+    }
+
+
+    // Producers split messages evenly, the consumer drains them all
+    template<typename Q>
+    double queue_throughput(unsigned producers_count) {
+        using message = typename Q::value_type;
+        auto const total = messages_count / 16 / producers_count
+                           * producers_count;
+        Q queue;
+        queue.reserve(queue_capacity);
+
+        auto consumer = std::thread {[&queue, total] {
+            for(std::int64_t i = 0; i != total;) {
+                auto const n = queue.try_fetch();
+                if(!n) {
+                    hydra::cpu_relax();
+                    continue;
+                }
+                queue.fetched();
+                ++i;
+            }
+        }};
+        pin_to_core(consumer, consumer_core);
+
+        auto const started = std::chrono::steady_clock::now();
+        std::vector<std::thread> producers;
+        for(unsigned p = 0; p != producers_count; ++p) {
+            producers.emplace_back([&queue, total, producers_count] {
+                for(std::int64_t i = 0; i != total / producers_count; ++i) {
+                    auto const n = queue.claim();
+                    queue[n] = message {};
+                    queue.publish(n);
+                }
+            });
+            pin_to_core(producers.back(), producer_core + 2 + p);
+        }
+        for(auto& producer: producers)
+            producer.join();
+        consumer.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(total) / elapsed.count();
+    }
+
+
+    template<std::size_t N>
+    void measure_throughputs(std::vector<bench::measurement>& report) {
+        bench::measurement m;
+        m.benchmark = "throughput";
+        m.message_size = N;
+        m.count = std::uint64_t(messages_count / 16);
+        m.subject = "spsc_queue";
+        m.throughput = queue_throughput<hydra::spsc_queue<payload<N>>>(1);
+        report.push_back(m);
+        m.subject = "mpsc_queue";
+        for(unsigned producers: {1u, 2u, 4u}) {
+            m.producers = producers;
+            m.throughput =
+                queue_throughput<hydra::mpsc_queue<payload<N>>>(producers);
+            report.push_back(m);
+        }
+    }
+
+
+
+    // Threads take the lock in turns, each one increments a counter
+    // guarded by it
+    template<typename L>
+    double lock_throughput(unsigned threads_count) {
+        auto const total = messages_count / 64 / threads_count
+                           * threads_count;
+        L lock;
+        std::int64_t counter = 0;
+
+        auto const started = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for(unsigned t = 0; t != threads_count; ++t) {
+            threads.emplace_back([&lock, &counter, total, threads_count] {
+                for(std::int64_t i = 0; i != total / threads_count; ++i) {
+                    lock.lock();
+                    ++counter;
+                    lock.unlock();
+                }
+            });
+            pin_to_core(threads.back(), producer_core + t);
+        }
+        for(auto& thread: threads)
+            thread.join();
+
+        auto const elapsed = std::chrono::duration<double, std::micro>(
+            std::chrono::steady_clock::now() - started);
+        return double(counter) / elapsed.count();
+    }
+
+
+    // Time from one unlock to the next successful lock, by the same
+    // thread or by another one waiting for it
+    template<typename L>
+    bench::latency_histogram lock_handoff_latency(unsigned threads_count) {
+        L lock;
+        std::int64_t released_at = 0;
+        std::vector<bench::latency_histogram> histograms(threads_count);
+
+        std::vector<std::thread> threads;
+        for(unsigned t = 0; t != threads_count; ++t) {
+            auto& histogram = histograms[t];
+            threads.emplace_back([&lock, &released_at, &histogram] {
+                for(std::int64_t i = 0; i != paced_messages_count; ++i) {
+                    lock.lock();
+                    auto const acquired_at = now_ns();
+                    if(released_at != 0)
+                        histogram.record(acquired_at - released_at);
+                    released_at = now_ns();
+                    lock.unlock();
+                }
+            });
+            pin_to_core(threads.back(), producer_core + t);
+        }
+        for(auto& thread: threads)
+            thread.join();
+
+        for(unsigned t = 1; t != threads_count; ++t)
+            histograms[0].merge(histograms[t]);
+        return histograms[0];
+    }
+
+
+    template<typename L>
+    void measure_lock(char const* name,
+                      std::vector<bench::measurement>& report) {
+        for(unsigned threads: {1u, 2u, 4u}) {
+            auto m = bench::latency_measurement(
+                "lock_handoff", name, threads, 0,
+                lock_handoff_latency<L>(threads));
+            report.push_back(m);
+        }
+        bench::measurement m;
+        m.benchmark = "lock_throughput";
+        m.subject = name;
+        for(unsigned threads: {1u, 2u, 4u}) {
+            m.producers = threads;
+            m.count = std::uint64_t(messages_count / 64 / threads * threads);
+            m.throughput = lock_throughput<L>(threads);
+            report.push_back(m);
+        }
+    }
+
+
+    // Latency percentiles and throughput in a form to be compared
+    // between runs
+    void benchmark_suite(bench::output_format format) {
+        using bench::latency_measurement;
+        constexpr auto size = sizeof(std::int64_t);
+        std::vector<bench::measurement> report;
+        report.push_back(latency_measurement(
+            "one_way", "spsc_queue", 1, size,
+            one_way_latency<hydra::spsc_queue<std::int64_t>>()));
+        report.push_back(latency_measurement(
+            "one_way", "mpsc_queue", 1, size,
+            one_way_latency<hydra::mpsc_queue<std::int64_t>>()));
+        report.push_back(latency_measurement(
+            "one_way", "activity", 1, size, activity_one_way_latency()));
+        report.push_back(latency_measurement(
+            "round_trip", "spsc_queue", 1, size,
+            round_trip_latency<hydra::spsc_queue<std::int64_t>>()));
+        report.push_back(latency_measurement(
+            "round_trip", "mpsc_queue", 1, size,
+            round_trip_latency<hydra::mpsc_queue<std::int64_t>>()));
+        report.push_back(latency_measurement(
+            "round_trip", "futex_event", 1, 0, futex_round_trip_latency()));
+        measure_throughputs<8>(report);
+        measure_throughputs<64>(report);
+        measure_throughputs<256>(report);
+        measure_lock<usync::spinlock>("usync::spinlock", report);
+        measure_lock<usync::shared_spinlock>("usync::shared_spinlock", report);
+        bench::print(report, format);
+    }
+
+
+
+    // Cost of a single queue operation on an uncontended queue,
+    // with hardware counters when the system allows them
+    template<typename Q>
+    void benchmark_operation_counters(char const* name) {
+        Q queue;
+        queue.reserve(queue_capacity);
+        std::int64_t value = 0;
+        auto const r = ubench::run_with_counters([&queue, &value] {
+            auto const n = queue.claim();
+            queue[n] = value;
+            queue.publish(n);
+            auto const m = queue.try_fetch();
+            value += queue[m];
+            queue.fetched();
+        });
+        std::cout << name << " claim/publish/fetch: " << r << '\n';
+    }
+
+
+    void benchmark_counters() {
+        benchmark_operation_counters<hydra::spsc_queue<std::int64_t>>(
+            "spsc_queue");
+        benchmark_operation_counters<hydra::mpsc_queue<std::int64_t>>(
+            "mpsc_queue");
+        hydra::futex_event event;
+        auto const r = ubench::run_with_counters([&event] {
+            event.notify_one();
+        });
+        std::cout << "futex_event::notify_one without waiters: " << r
+                  << std::endl;
+    }
+
+
+    // Cached opposite cursors against reading them on every operation,
+    // cache misses show the cursor lines no longer bouncing per message
+    void benchmark_cursor_caching() {
+        print("spsc_queue, cached cursors:",
+              ping_pong_throughput<hydra::spsc_queue<std::int64_t>>());
+        print("spsc_queue, uncached cursors:",
+              ping_pong_throughput<uncached_spsc_queue<std::int64_t>>());
+        benchmark_operation_counters<hydra::spsc_queue<std::int64_t>>(
+            "spsc_queue, cached cursors,");
+        benchmark_operation_counters<uncached_spsc_queue<std::int64_t>>(
+            "spsc_queue, uncached cursors,");
+    }
+
+
+}   // namespace
+
+
+// Usage: hydra-benchmark [messages count] [--csv | --json],
+// machine-readable formats run the latency and throughput suite only
+int main(int argc, char** argv) {
+    auto format = bench::output_format::text;
+    for(int i = 1; i != argc; ++i) {
+        if(std::strcmp(argv[i], "--csv") == 0)
+            format = bench::output_format::csv;
+        else if(std::strcmp(argv[i], "--json") == 0)
+            format = bench::output_format::json;
+        else
+            messages_count = std::atoll(argv[i]);
+    }
+
+    if(format != bench::output_format::text) {
+        benchmark_suite(format);
+        return 0;
+    }
+
+    benchmark_layouts<hydra::spsc_queue>("spsc_queue");
+    benchmark_layouts<hydra::mpsc_queue>("mpsc_queue");
+    benchmark_cursor_caching();
+    benchmark_notifications();
+    benchmark_counters();
+    benchmark_wait_strategies();
+    benchmark_back_pressures();
+    benchmark_mpmc_scaling();
+    benchmark_pool_scaling();
+    benchmark_skewed_load();
+    benchmark_broadcast();
+    benchmark_pipeline();
+    benchmark_unbounded();
+    benchmark_resize();
+    benchmark_text_messages();
+    benchmark_slot_lifetimes();
+    benchmark_bulk_copy();
+    benchmark_slot_layouts();
+    benchmark_ring_memory();
+#if defined(__linux__)
+    benchmark_shared_queues();
+    benchmark_journal();
+#endif
+    benchmark_suite(format);
     return 0;
 }
@@ -0,0 +1,208 @@
+#pragma once
+
+
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+
+namespace bench {
+
+
+    // Log-linear buckets in the manner of HdrHistogram: values below
+    // 2^sub_bits are kept exactly, larger ones keep their sub_bits
+    // most significant bits, so relative error is below 1/2^(sub_bits-1)
+    class latency_histogram {
+    public:
+        static constexpr unsigned sub_bits = 6;
+
+    private:
+        static constexpr std::uint64_t sub_count = std::uint64_t(1) << sub_bits;
+        static constexpr std::uint64_t half_count = sub_count / 2;
+
+        std::vector<std::uint64_t> counts_ =
+            std::vector<std::uint64_t>(sub_count
+                                       + (64 - sub_bits) * half_count);
+        std::uint64_t total_ {0};
+        std::int64_t max_ {0};
+
+    public:
+        // Negative values are recorded as zero
+        void record(std::int64_t value) noexcept {
+            auto const v = value < 0 ? 0 : std::uint64_t(value);
+            ++counts_[index_of(v)];
+            ++total_;
+            if(std::int64_t(v) > max_)
+                max_ = std::int64_t(v);
+        }
+
+
+        void merge(latency_histogram const& other) noexcept {
+            for(std::size_t i = 0; i != counts_.size(); ++i)
+                counts_[i] += other.counts_[i];
+            total_ += other.total_;
+            if(other.max_ > max_)
+                max_ = other.max_;
+        }
+
+
+        std::uint64_t count() const noexcept { return total_; }
+        std::int64_t max() const noexcept { return max_; }
+
+
+        // Highest value of the bucket holding the given percentile,
+        // percentile is within [0, 100]
+        std::int64_t percentile(double p) const noexcept {
+            if(total_ == 0)
+                return 0;
+            auto const rank = std::uint64_t(
+                std::ceil(p / 100. * double(total_)));
+            std::uint64_t seen = 0;
+            for(std::size_t i = 0; i != counts_.size(); ++i) {
+                seen += counts_[i];
+                if(seen != 0 && seen >= rank) {
+                    auto const highest = std::int64_t(highest_of(i));
+                    return highest < max_ ? highest : max_;
+                }
+            }
+            return max_;
+        }
+
+    private:
+        static std::size_t index_of(std::uint64_t v) noexcept {
+            if(v < sub_count)
+                return std::size_t(v);
+            auto const shift = unsigned(std::bit_width(v)) - sub_bits;
+            return std::size_t(sub_count + (shift - 1) * half_count
+                               + ((v >> shift) - half_count));
+        }
+
+
+        static std::uint64_t highest_of(std::size_t index) noexcept {
+            if(index < sub_count)
+                return index;
+            auto const shift = (index - sub_count) / half_count + 1;
+            auto const sub = (index - sub_count) % half_count + half_count;
+            return ((sub + 1) << shift) - 1;
+        }
+    };   // latency_histogram
+
+
+    enum class output_format { text, csv, json };
+
+
+    // One line of a report, throughput or latencies may be missing
+    struct measurement {
+        std::string benchmark;
+        std::string subject;
+        unsigned producers {1};
+        std::size_t message_size {0};
+        std::uint64_t count {0};
+        // Millions of messages per second, negative if not measured
+        double throughput {-1.};
+        // Nanoseconds, none of them is measured when count is zero
+        std::int64_t p50 {0};
+        std::int64_t p99 {0};
+        std::int64_t p999 {0};
+        std::int64_t max {0};
+        bool latencies {false};
+    };   // measurement
+
+
+    inline measurement latency_measurement(std::string benchmark,
+                                           std::string subject,
+                                           unsigned producers,
+                                           std::size_t message_size,
+                                           latency_histogram const& h) {
+        measurement m;
+        m.benchmark = std::move(benchmark);
+        m.subject = std::move(subject);
+        m.producers = producers;
+        m.message_size = message_size;
+        m.count = h.count();
+        m.p50 = h.percentile(50.);
+        m.p99 = h.percentile(99.);
+        m.p999 = h.percentile(99.9);
+        m.max = h.max();
+        m.latencies = true;
+        return m;
+    }
+
+
+    inline void print(std::vector<measurement> const& report,
+                      output_format format) {
+        switch(format) {
+        case output_format::text:
+            for(auto const& m: report) {
+                std::printf("%-12s %-24s %2u x %4zu B",
+                            m.benchmark.data(),
+                            m.subject.data(),
+                            m.producers,
+                            m.message_size);
+                if(m.throughput >= 0.)
+                    std::printf("  %8.2f M/s", m.throughput);
+                if(m.latencies)
+                    std::printf("  p50 %7lld  p99 %7lld  p99.9 %7lld"
+                                "  max %8lld ns",
+                                (long long)m.p50,
+                                (long long)m.p99,
+                                (long long)m.p999,
+                                (long long)m.max);
+                std::printf("\n");
+            }
+            return;
+        case output_format::csv:
+            std::printf("benchmark,subject,producers,message_size,count,"
+                        "throughput_mps,p50_ns,p99_ns,p999_ns,max_ns\n");
+            for(auto const& m: report) {
+                std::printf("%s,%s,%u,%zu,%llu,",
+                            m.benchmark.data(),
+                            m.subject.data(),
+                            m.producers,
+                            m.message_size,
+                            (unsigned long long)m.count);
+                if(m.throughput >= 0.)
+                    std::printf("%.4f", m.throughput);
+                if(m.latencies)
+                    std::printf(",%lld,%lld,%lld,%lld\n",
+                                (long long)m.p50,
+                                (long long)m.p99,
+                                (long long)m.p999,
+                                (long long)m.max);
+                else
+                    std::printf(",,,,\n");
+            }
+            return;
+        case output_format::json:
+            std::printf("[\n");
+            for(std::size_t i = 0; i != report.size(); ++i) {
+                auto const& m = report[i];
+                std::printf("  {\"benchmark\": \"%s\", \"subject\": \"%s\", "
+                            "\"producers\": %u, \"message_size\": %zu, "
+                            "\"count\": %llu",
+                            m.benchmark.data(),
+                            m.subject.data(),
+                            m.producers,
+                            m.message_size,
+                            (unsigned long long)m.count);
+                if(m.throughput >= 0.)
+                    std::printf(", \"throughput_mps\": %.4f", m.throughput);
+                if(m.latencies)
+                    std::printf(", \"p50_ns\": %lld, \"p99_ns\": %lld, "
+                                "\"p999_ns\": %lld, \"max_ns\": %lld",
+                                (long long)m.p50,
+                                (long long)m.p99,
+                                (long long)m.p999,
+                                (long long)m.max);
+                std::printf("}%s\n", i + 1 != report.size() ? "," : "");
+            }
+            std::printf("]\n");
+            return;
+        }
+    }
+
+
+}   // namespace bench
@@ -2,17 +2,68 @@
 
 
 
+#include <algorithm>
 #include <chrono>
-#include <set>
+#include <cstdint>
+#include <vector>
 #include <iosfwd>
 #include <iomanip>
 
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
 
 
 namespace ubench {
 
 
 
+// Per iteration values of hardware and software events,
+// an event is missing when the system refused to count it
+struct counters {
+
+  enum event {
+    cycles, instructions, cache_misses, branch_misses, context_switches,
+    events_count
+  };
+
+  double value[events_count]{};
+  unsigned measured{0};
+
+  bool has(event e) const noexcept { return (measured & (1u << e)) != 0; }
+  double operator [] (event e) const noexcept { return value[e]; }
+
+
+  static char const* name(event e) noexcept {
+    switch(e) {
+      case cycles:
+        return "cycles";
+      case instructions:
+        return "instructions";
+      case cache_misses:
+        return "cache misses";
+      case branch_misses:
+        return "branch misses";
+      case context_switches:
+        return "context switches";
+      default:
+        return "unknown";
+    }
+  }
+}; // counters
+
+
+
 struct result {
 
   enum code {
@@ -23,6 +74,9 @@ struct result {
 
   code code{ok};
   timing time{0.};
+  // Time stamp counter ticks per iteration, zero if there is no counter
+  double tsc_cycles{0.};
+  counters events;
   std::chrono::microseconds took{0};
 
   result() noexcept = default;
@@ -56,7 +110,15 @@ struct result {
     operator << (std::basic_ostream<charT, traits>& os, result const& r) noexcept {
       if(!r)
         return os << "unable to benchmark because " << r.message();
-      return os << std::setprecision(1) << std::fixed << r.time.count() << " ns";
+      os << std::setprecision(1) << std::fixed << r.time.count() << " ns";
+      if(r.tsc_cycles > 0.)
+        os << ", " << r.tsc_cycles << " tsc cycles";
+      for(unsigned e = 0; e != counters::events_count; ++e) {
+        auto const event = counters::event(e);
+        if(r.events.has(event))
+          os << ", " << r.events[event] << ' ' << counters::name(event);
+      }
+      return os;
     }
 }; // result
 
@@ -65,8 +127,136 @@ struct result {
 #ifdef _MSC_VER
 #define UBENCH_NOINLINE __declspec(noinline)
 #else
-#define UBENCH_NOINLINE __attribute__(noinline)
+#define UBENCH_NOINLINE __attribute__((noinline))
+#endif
+
+
+
+// Reads the time stamp counter, cycles of constant rate on x86,
+// generic timer ticks on ARM
+inline std::uint64_t rdtsc() noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  return __rdtsc();
+#elif defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return 0;
+#endif
+}
+
+
+
+// Group of perf_event_open counters of the calling thread, read
+// at once to be consistent. Events the kernel refuses to count
+// (no PMU in a virtual machine, perf_event_paranoid) are left out,
+// the group is empty when none of them is available
+class perf_group {
+public:
+
+  struct reading {
+    std::uint64_t enabled{0};
+    std::uint64_t running{0};
+    std::uint64_t value[counters::events_count]{};
+  };
+
+private:
+
+#if defined(__linux__)
+  int fds_[counters::events_count];
+  counters::event order_[counters::events_count];
+  unsigned opened_{0};
+#endif
+  unsigned measured_{0};
+
+public:
+
+  perf_group() noexcept {
+#if defined(__linux__)
+    for(auto& fd: fds_)
+      fd = -1;
+    open(counters::cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true);
+    open(counters::instructions, PERF_TYPE_HARDWARE,
+         PERF_COUNT_HW_INSTRUCTIONS, true);
+    open(counters::cache_misses, PERF_TYPE_HARDWARE,
+         PERF_COUNT_HW_CACHE_MISSES, true);
+    open(counters::branch_misses, PERF_TYPE_HARDWARE,
+         PERF_COUNT_HW_BRANCH_MISSES, true);
+    // Switches happen in the kernel, they are not seen from user mode
+    open(counters::context_switches, PERF_TYPE_SOFTWARE,
+         PERF_COUNT_SW_CONTEXT_SWITCHES, false);
+    if(opened_ != 0) {
+      ioctl(fds_[order_[0]], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(fds_[order_[0]], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+
+  perf_group(perf_group const&) = delete;
+  perf_group& operator = (perf_group const&) = delete;
+
+
+  ~perf_group() {
+#if defined(__linux__)
+    for(int fd: fds_)
+      if(fd != -1)
+        close(fd);
+#endif
+  }
+
+
+  explicit operator bool () const noexcept { return measured_ != 0; }
+  unsigned measured() const noexcept { return measured_; }
+
+
+  bool read(reading& r) const noexcept {
+#if defined(__linux__)
+    if(opened_ == 0)
+      return false;
+    std::uint64_t buffer[3 + counters::events_count];
+    auto const size = ssize_t(sizeof(std::uint64_t) * (3 + opened_));
+    if(::read(fds_[order_[0]], buffer, std::size_t(size)) != size)
+      return false;
+    r.enabled = buffer[1];
+    r.running = buffer[2];
+    for(unsigned i = 0; i != opened_; ++i)
+      r.value[order_[i]] = buffer[3 + i];
+    return true;
+#else
+    (void)r;
+    return false;
 #endif
+  }
+
+private:
+
+#if defined(__linux__)
+  void open(counters::event e, std::uint32_t type, std::uint64_t config,
+            bool user_only) noexcept {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = opened_ == 0 ? 1 : 0;
+    attr.exclude_kernel = user_only ? 1 : 0;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP
+                       | PERF_FORMAT_TOTAL_TIME_ENABLED
+                       | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    int const leader = opened_ == 0 ? -1 : fds_[order_[0]];
+    int const fd = int(syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0));
+    if(fd == -1)
+      return;
+    fds_[e] = fd;
+    order_[opened_++] = e;
+    measured_ |= 1u << e;
+  }
+#endif
+}; // perf_group
 
 
 
@@ -76,15 +266,37 @@ inline std::chrono::microseconds elapsed_us(std::chrono::steady_clock::time_poin
   using namespace std::chrono;  
   return duration_cast<microseconds>(steady_clock::now() - tp);
 }
-  
-} // detail
 
 
+struct sample {
+  std::chrono::steady_clock::duration time;
+  std::uint64_t tsc;
+  perf_group::reading events;
+};
+
+
+// Counters of an empty sample, the cost of reading them
+inline perf_group::reading overhead(perf_group const& group) noexcept {
+  perf_group::reading lowest;
+  for(auto& value: lowest.value)
+    value = UINT64_MAX;
+  for(unsigned i = 0; i != 10; ++i) {
+    perf_group::reading before, after;
+    if(!group.read(before) || !group.read(after))
+      return perf_group::reading{};
+    for(unsigned e = 0; e != counters::events_count; ++e)
+      lowest.value[e] = (std::min)(lowest.value[e],
+                                   after.value[e] - before.value[e]);
+  }
+  return lowest;
+}
 
-template<typename F> result UBENCH_NOINLINE
-run(F&& f,
-    unsigned nof_tests = 10,
-    std::chrono::steady_clock::duration min_duration = std::chrono::steady_clock::duration{5000}) {
+
+template<typename F> result
+measure(F& f,
+        unsigned nof_tests,
+        std::chrono::steady_clock::duration min_duration,
+        perf_group const* group) {
   
   using namespace std::chrono;
 
@@ -104,29 +316,89 @@ run(F&& f,
   } while(n <= max_iterations);
 
   if(elapsed < min_duration)
-    return {result::optimized, detail::elapsed_us(origin)};
+    return {result::optimized, elapsed_us(origin)};
+
+  perf_group::reading const empty =
+    group != nullptr ? overhead(*group) : perf_group::reading{};
 
-  std::multiset<steady_clock::duration> samples;
+  std::vector<sample> samples;
+  samples.reserve(nof_tests);
   for(unsigned i = 0; i != nof_tests; ++i) {
+    perf_group::reading before, after;
+    if(group != nullptr)
+      group->read(before);
+    auto const started_tsc = rdtsc();
     auto const started = steady_clock::now();
     for(unsigned j = 0; j != n; ++j)
       f();
-    samples.emplace(steady_clock::now() - started);
+    auto const time = steady_clock::now() - started;
+    auto const tsc = rdtsc() - started_tsc;
+    if(group != nullptr)
+      group->read(after);
+
+    sample s{time, tsc, {}};
+    s.events.enabled = after.enabled - before.enabled;
+    s.events.running = after.running - before.running;
+    for(unsigned e = 0; e != counters::events_count; ++e) {
+      auto const value = after.value[e] - before.value[e];
+      s.events.value[e] = value > empty.value[e] ? value - empty.value[e] : 0;
+    }
+    samples.push_back(s);
   }
 
   // filter "cold" results
-  for(unsigned i = 0; i != nof_tests / 5; ++i) {
-    auto end = samples.end();
-    samples.erase(--end);
-  }
+  std::sort(samples.begin(), samples.end(),
+            [](sample const& x, sample const& y) { return x.time < y.time; });
+  samples.resize(samples.size() - nof_tests / 5);
 
   steady_clock::duration::rep average = 0;
-  for(steady_clock::duration const& each: samples)
-    average += each.count();
+  std::uint64_t tsc = 0;
+  perf_group::reading total;
+  for(sample const& each: samples) {
+    average += each.time.count();
+    tsc += each.tsc;
+    total.enabled += each.events.enabled;
+    total.running += each.events.running;
+    for(unsigned e = 0; e != counters::events_count; ++e)
+      total.value[e] += each.events.value[e];
+  }
   average /= samples.size();
   
   auto const ns = duration_cast<nanoseconds>(steady_clock::duration{average}).count();
-  return {result::timing{double(ns) / n}, detail::elapsed_us(origin)};
+  result r{result::timing{double(ns) / n}, elapsed_us(origin)};
+  auto const iterations = double(n) * double(samples.size());
+  r.tsc_cycles = double(tsc) / iterations;
+
+  // Counters were multiplexed when they did not run all the time
+  if(group != nullptr && total.running != 0) {
+    auto const scale = double(total.enabled) / double(total.running);
+    r.events.measured = group->measured();
+    for(unsigned e = 0; e != counters::events_count; ++e)
+      r.events.value[e] = double(total.value[e]) * scale / iterations;
+  }
+  return r;
+}
+  
+} // detail
+
+
+
+template<typename F> result UBENCH_NOINLINE
+run(F&& f,
+    unsigned nof_tests = 10,
+    std::chrono::steady_clock::duration min_duration = std::chrono::steady_clock::duration{5000}) {
+  return detail::measure(f, nof_tests, min_duration, nullptr);
+}
+
+
+
+// As run, also counts hardware and software events per iteration
+template<typename F> result UBENCH_NOINLINE
+run_with_counters(F&& f,
+                  unsigned nof_tests = 10,
+                  std::chrono::steady_clock::duration min_duration = std::chrono::steady_clock::duration{5000}) {
+  perf_group const group;
+  return detail::measure(f, nof_tests, min_duration, group ? &group : nullptr);
 }
 
 
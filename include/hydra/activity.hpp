@@ -2,22 +2,32 @@
 
 
 #include <atomic>
+#include <chrono>
 #include <memory>
 #include <thread>
+#include <utility>
 
 #include <hydra/batch.hpp>
 #include <hydra/futex_event.hpp>
+#include <hydra/metrics.hpp>
 #include <hydra/mpsc_queue.hpp>
+#include <hydra/ring_memory.hpp>
+#include <hydra/wait_strategy.hpp>
 
 
 namespace hydra {
 
 
-    template<typename M, typename Q = mpsc_queue<M>>
+    // W is the wait strategy of the idle worker and of producers
+    // waiting for room in the queue
+    template<typename M,
+             typename Q = mpsc_queue<M>,
+             typename W = blocking_wait>
     class activity {
     public:
         using message_type = M;
         using queue_type = Q;
+        using wait_strategy = W;
         using size_type = typename Q::size_type;
         using batch_type = batch<Q>;
 
@@ -25,39 +35,127 @@ namespace hydra {
         std::thread worker_;
         queue_type messages_;
         futex_event new_message_;
-        std::uint32_t messages_processed_ {0};
+        std::atomic<size_type> resize_to_ {0};
         std::atomic_flag stopping_ {};
+        wait_strategy wait_;
+        metrics metrics_;
 
     public:
         activity() noexcept = default;
+        explicit activity(wait_strategy wait) noexcept: wait_ {wait} {}
         activity(activity const&) noexcept = delete;
         activity& operator=(activity const&) noexcept = delete;
         ~activity() { stop(); }
         bool active() const noexcept { return worker_.joinable(); }
-        sequence claim() noexcept { return messages_.claim(); }
+        sequence claim() noexcept { return messages_.claim(wait_); }
+        sequence_range claim_n(size_type count) noexcept {
+            return messages_.claim_n(count, wait_);
+        }
         message_type& operator[](sequence n) noexcept { return messages_[n]; }
         void reserve(size_type n) noexcept { messages_.reserve(n); }
+        void reserve(size_type n, memory_options const& memory) {
+            messages_.reserve(n, memory);
+        }
+        // Queue specific operations, such as sync and replay
+        // of journal_queue
+        queue_type& queue() noexcept { return messages_; }
+        queue_type const& queue() const noexcept { return messages_; }
+        // Opens a queue backed by files, such as journal_queue
+        template<typename... Args>
+        bool open(Args&&... args) {
+            return messages_.open(std::forward<Args>(args)...);
+        }
         size_type blocks_count() const noexcept {
             return messages_.blocks_count();
         }
+        std::chrono::nanoseconds blocked_time() const noexcept {
+            return messages_.blocked_time();
+        }
+        void park_producers(size_type release_threshold) noexcept {
+            messages_.park_producers(release_threshold);
+        }
+        size_type resizes_count() const noexcept {
+            return messages_.resizes_count();
+        }
+        std::chrono::nanoseconds resize_time() const noexcept {
+            return messages_.resize_time();
+        }
+
+
+        // Safe to call from any thread while the activity runs
+        metrics_snapshot snapshot() const noexcept {
+            auto s = metrics_.snapshot();
+            if constexpr(requires { messages_.blocked_time(); }) {
+                s.claims_blocked = messages_.blocks_count();
+                s.blocked_time = messages_.blocked_time();
+            }
+            s.wake_syscalls = new_message_.syscalls_count();
+            return s;
+        }
 
         template<typename Rep, typename Period>
         sequence claim_for(
             std::chrono::duration<Rep, Period> const& duration) noexcept {
-            return messages_.claim_for(duration);
+            return messages_.claim_for(duration, wait_);
         }
 
 
         void publish(sequence n) noexcept {
             messages_.publish(n);
+            metrics_.published(1, true);
+            new_message_.notify_one();
+        }
+
+
+        template<typename... Args>
+        void construct(sequence n, Args&&... args) {
+            messages_.construct(n, std::forward<Args>(args)...);
+        }
+
+
+        // Claims, constructs and publishes a message
+        template<typename... Args>
+        sequence emplace(Args&&... args) {
+            auto const n = claim();
+            if(!n)
+                return n;
+            messages_.construct(n, std::forward<Args>(args)...);
+            publish(n);
+            return n;
+        }
+
+
+        // Publishes sequences [first, last) with a single wakeup
+        void publish_range(sequence first, sequence last) noexcept {
+            messages_.publish_range(first, last);
+            metrics_.published(std::uint64_t(last.value() - first.value()),
+                               true);
+            new_message_.notify_one();
+        }
+
+
+        void publish_range(sequence_range const& range) noexcept {
+            publish_range(range.first(), range.last());
+        }
+
+
+        // Queue is resized by the worker between batches
+        void resize(size_type capacity) {
+            if(!worker_.joinable()) {
+                messages_.resize(capacity);
+                return;
+            }
+            resize_to_.store(capacity, std::memory_order_release);
+            metrics_.woke();
             new_message_.notify_one();
         }
 
 
         void stop() noexcept {
             if(!worker_.joinable()
-               || stopping_.test_and_set(std::memory_order_relaxed))
+               || stopping_.test_and_set(std::memory_order_release))
                 return;
+            metrics_.woke();
             new_message_.notify_one();
             worker_.join();
         }
@@ -69,26 +167,38 @@ namespace hydra {
                 return false;
 
             worker_ = std::thread {[handler, this]() {
-                if(messages_.size() != 0) {
-                    auto messages = batch<Q> {messages_};
-                    handler(messages);
-                    messages_processed_ += messages.fetched_count();
-                }
+                for(;;) {
+                    wait_.wait_until(new_message_, [this] {
+                        return messages_.ready()
+                               || resize_to_.load(std::memory_order_relaxed)
+                                      != 0
+                               || stopping_.test(std::memory_order_acquire);
+                    });
+
+                    if constexpr(requires { messages_.resize(size_type {}); }) {
+                        auto const capacity =
+                            resize_to_.exchange(0, std::memory_order_acquire);
+                        if(capacity != 0)
+                            messages_.resize(capacity);
+                    }
 
-                while(!stopping_.test_and_set(std::memory_order_relaxed)) {
-                    stopping_.clear(std::memory_order_relaxed);
-                    new_message_.wait(messages_processed_);
-                    if(messages_.size() != 0) {
+                    bool const stopping =
+                        stopping_.test(std::memory_order_acquire);
+
+                    if(messages_.ready()) {
+                        auto const started = std::chrono::steady_clock::now();
                         auto messages = batch<Q> {messages_};
                         handler(messages);
-                        messages_processed_ += messages.fetched_count();
+                        metrics_.batch_done(
+                            std::uint64_t(messages.size()),
+                            messages.fetched_count(),
+                            std::chrono::steady_clock::now() - started);
+                        if(!stopping || messages.fetched_count() != 0)
+                            continue;
                     }
-                }
 
-                if(messages_.size() != 0) {
-                    auto messages = batch<Q> {messages_};
-                    handler(messages);
-                    messages_processed_ += messages.fetched_count();
+                    if(stopping)
+                        break;
                 }
 
                 stopping_.clear(std::memory_order_relaxed);
@@ -0,0 +1,158 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <hydra/batch.hpp>
+#include <hydra/futex_event.hpp>
+#include <hydra/mpmc_queue.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    // Like activity, but runs the handler on several workers draining
+    // one queue with several consumers, each worker with its own batch
+    template<typename M,
+             typename Q = mpmc_queue<M>,
+             typename W = blocking_wait>
+    class activity_pool {
+    public:
+        using message_type = M;
+        using queue_type = Q;
+        using wait_strategy = W;
+        using size_type = typename Q::size_type;
+        using batch_type = batch<Q>;
+
+        static_assert(shared_consumer_queue<Q>,
+                      "activity_pool needs a queue with several consumers");
+
+    private:
+        std::vector<std::thread> workers_;
+        queue_type messages_;
+        futex_event new_message_;
+        std::atomic<std::uint64_t> messages_processed_ {0};
+        std::atomic_flag stopping_ {};
+        wait_strategy wait_;
+
+    public:
+        activity_pool() noexcept = default;
+        explicit activity_pool(wait_strategy wait) noexcept: wait_ {wait} {}
+        activity_pool(activity_pool const&) noexcept = delete;
+        activity_pool& operator=(activity_pool const&) noexcept = delete;
+        ~activity_pool() { stop(); }
+        bool active() const noexcept { return !workers_.empty(); }
+        std::size_t workers_count() const noexcept { return workers_.size(); }
+        sequence claim() noexcept { return messages_.claim(wait_); }
+        sequence_range claim_n(size_type count) noexcept {
+            return messages_.claim_n(count, wait_);
+        }
+        message_type& operator[](sequence n) noexcept { return messages_[n]; }
+        void reserve(size_type n) noexcept { messages_.reserve(n); }
+        size_type blocks_count() const noexcept {
+            return messages_.blocks_count();
+        }
+        std::chrono::nanoseconds blocked_time() const noexcept {
+            return messages_.blocked_time();
+        }
+        std::uint64_t messages_processed() const noexcept {
+            return messages_processed_.load(std::memory_order_relaxed);
+        }
+
+        template<typename Rep, typename Period>
+        sequence claim_for(
+            std::chrono::duration<Rep, Period> const& duration) noexcept {
+            return messages_.claim_for(duration, wait_);
+        }
+
+
+        void publish(sequence n) noexcept {
+            messages_.publish(n);
+            new_message_.notify_one();
+        }
+
+
+        // Publishes sequences [first, last), bursts wake every worker
+        void publish_range(sequence first, sequence last) noexcept {
+            messages_.publish_range(first, last);
+            if(last.value() - first.value() > 1)
+                new_message_.notify_all();
+            else
+                new_message_.notify_one();
+        }
+
+
+        void publish_range(sequence_range const& range) noexcept {
+            publish_range(range.first(), range.last());
+        }
+
+
+        // Workers drain the queue before exit
+        void stop() noexcept {
+            if(workers_.empty()
+               || stopping_.test_and_set(std::memory_order_release))
+                return;
+            new_message_.notify_all();
+            for(auto& worker: workers_)
+                worker.join();
+            workers_.clear();
+            stopping_.clear(std::memory_order_relaxed);
+        }
+
+
+        template<typename H>
+        bool run(H&& handler,
+                 unsigned workers_count = std::thread::hardware_concurrency()) {
+            if(!workers_.empty() || !messages_)
+                return false;
+
+            if(workers_count == 0)
+                workers_count = 1;
+
+            workers_.reserve(workers_count);
+            for(unsigned i = 0; i != workers_count; ++i)
+                workers_.emplace_back([handler, this]() mutable {
+                    work(handler);
+                });
+
+            return true;
+        }
+
+
+    private:
+        template<typename H>
+        void work(H& handler) {
+            for(;;) {
+                wait_.wait_until(new_message_, [this] {
+                    return messages_.ready()
+                           || stopping_.test(std::memory_order_acquire);
+                });
+
+                bool const stopping = stopping_.test(std::memory_order_acquire);
+
+                if(messages_.ready()) {
+                    auto messages = batch<Q> {messages_};
+                    handler(messages);
+                    messages_processed_.fetch_add(messages.fetched_count(),
+                                                  std::memory_order_relaxed);
+                    if(!stopping || messages.fetched_count() != 0)
+                        continue;
+                }
+
+                if(stopping)
+                    break;
+            }
+        }
+
+    };   // activity_pool
+
+
+}   // namespace hydra
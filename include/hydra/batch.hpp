@@ -1,12 +1,33 @@
 #pragma once
 
 
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+#include <hydra/ring_span.hpp>
 #include <hydra/sequence.hpp>
 
 
 namespace hydra {
 
 
+    // Queues with several consumers release fetched messages by sequence
+    template<typename Q>
+    concept shared_consumer_queue = requires(Q& queue, sequence n) {
+        queue.fetched(n);
+    };
+
+
+    // Queues of trivially copyable messages copy them out at once
+    template<typename Q>
+    concept bulk_copy_queue = requires(Q& queue,
+                                       typename Q::value_type* out,
+                                       typename Q::size_type max) {
+        queue.try_pop_bulk(out, max);
+    };
+
+
     template<typename Q>
     class batch {
     public:
@@ -16,7 +37,10 @@ namespace hydra {
     private:
         Q& queue_;
         size_type size_;
+        size_type limit_ {(std::numeric_limits<size_type>::max)()};
+        size_type taken_ {0};
         std::uint32_t fetched_count_ {0};
+        sequence fetching_;
 
     public:
         batch() = delete;
@@ -24,15 +48,71 @@ namespace hydra {
         batch& operator=(const batch&) = delete;
         batch(Q& queue) noexcept: queue_(queue), size_ {queue.size()} {}
 
+        // Batch takes no more than limit messages from the queue
+        batch(Q& queue, size_type limit) noexcept
+            : queue_(queue),
+              size_ {(std::min)(queue.size(), limit)},
+              limit_ {limit} {}
+
         size_type size() const noexcept { return size_; }
-        sequence try_fetch() { return queue_.try_fetch(); }
         value_type& operator[](sequence n) { return queue_[n]; }
         std::uint32_t fetched_count() const noexcept { return fetched_count_; }
 
+        sequence try_fetch() {
+            if(taken_ == limit_)
+                return sequence{};
+            fetching_ = queue_.try_fetch();
+            if constexpr(shared_consumer_queue<Q>)
+                taken_ += !!fetching_ ? 1 : 0;
+            return fetching_;
+        }
+
+
         void fetched() {
-            queue_.fetched();
+            if constexpr(shared_consumer_queue<Q>) {
+                queue_.fetched(fetching_);
+            } else {
+                queue_.fetched();
+                ++taken_;
+            }
             ++fetched_count_;
         }
+
+
+        // Returns up to max ready messages as contiguous spans,
+        // they are released by fetched(n); queues with several consumers
+        // need all of them to be released at once
+        ring_span<value_type> fetch_available(size_type max) {
+            auto const messages =
+                queue_.fetch_available((std::min)(max, limit_ - taken_));
+            fetching_ = messages.first;
+            if constexpr(shared_consumer_queue<Q>)
+                taken_ += size_type(messages.size());
+            return messages;
+        }
+
+
+        void fetched(size_type count) {
+            if constexpr(shared_consumer_queue<Q>) {
+                queue_.fetched(fetching_, count);
+            } else {
+                queue_.fetched(count);
+                taken_ += count;
+            }
+            fetched_count_ += std::uint32_t(count);
+        }
+
+
+        // Copies up to max messages out of the queue at once
+        size_type try_pop_bulk(value_type* out, size_type max)
+            requires bulk_copy_queue<Q>
+        {
+            auto const count =
+                queue_.try_pop_bulk(out, (std::min)(max, limit_ - taken_));
+            taken_ += count;
+            fetched_count_ += std::uint32_t(count);
+            return count;
+        }
     };   // batch
 
 
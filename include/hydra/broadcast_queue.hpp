@@ -0,0 +1,385 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <hydra/cacheline.hpp>
+#include <hydra/ring_span.hpp>
+#include <hydra/sequence.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    // Every published message is seen by every subscribed consumer,
+    // each consumer has its own cursor, producers wait for the slowest;
+    // a consumer may follow upstream consumers and see a message only
+    // after all of them fetched it
+    template<typename T, std::size_t Alignment = cacheline_size>
+    class broadcast_queue {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = T;
+
+        static_assert(is_valid_layout(Alignment));
+
+    private:
+        using sequence_value = sequence::value_type;
+
+    public:
+        // Cursor of a single consumer with the consumer API of spsc_queue
+        class consumer {
+        public:
+            using size_type = broadcast_queue::size_type;
+            using value_type = T;
+
+        private:
+            friend class broadcast_queue;
+
+            alignas(Alignment) std::atomic<sequence_value> cursor_;
+            sequence_value published_until_;
+            sequence_value upstream_until_;
+            broadcast_queue& queue_;
+            std::vector<consumer const*> upstreams_;
+
+        public:
+            consumer(broadcast_queue& queue,
+                     sequence_value start,
+                     std::vector<consumer const*> upstreams)
+                : cursor_ {start},
+                  published_until_ {start},
+                  upstream_until_ {upstreams.empty()
+                                       ? (std::numeric_limits<
+                                           sequence_value>::max)()
+                                       : start},
+                  queue_ {queue},
+                  upstreams_ {std::move(upstreams)} {}
+            consumer(consumer const&) = delete;
+            consumer& operator=(consumer const&) = delete;
+            T& operator[](sequence n) noexcept { return queue_[n]; }
+            sequence cursor() const noexcept {
+                return sequence {cursor_.load(std::memory_order_relaxed)};
+            }
+            size_type size() const noexcept {
+                return queue_.producer_.load(std::memory_order_relaxed)
+                       - cursor_.load(std::memory_order_relaxed);
+            }
+
+
+            sequence try_fetch() noexcept {
+                if(!queue_.pool_)
+                    return sequence {};
+
+                auto const c = cursor_.load(std::memory_order_relaxed);
+                if(!available(c))
+                    return sequence {};
+
+                return sequence {c};
+            }
+
+
+            bool ready() noexcept { return !!try_fetch(); }
+
+
+            void fetched() noexcept {
+                cursor_.store(cursor_.load(std::memory_order_relaxed) + 1,
+                              std::memory_order_release);
+            }
+
+
+            // Returns up to max published messages following the cursor
+            ring_span<T> fetch_available(size_type max) noexcept {
+                if(!queue_.pool_ || max <= 0)
+                    return ring_span<T> {};
+
+                auto const c = cursor_.load(std::memory_order_relaxed);
+                auto n = c;
+                while(n - c < max && available(n))
+                    n = (std::min)(
+                        {published_until_, upstream_until_, c + max});
+
+                return queue_.span(c, n - c);
+            }
+
+
+            void fetched(size_type count) noexcept {
+                cursor_.store(cursor_.load(std::memory_order_relaxed) + count,
+                              std::memory_order_release);
+            }
+
+
+        private:
+            // Rereads upstream cursors only when the cached minimum is
+            // reached, consumers without upstreams have it at maximum
+            bool available(sequence_value c) noexcept {
+                if(!queue_.published(c, published_until_))
+                    return false;
+                if(c < upstream_until_)
+                    return true;
+
+                auto slowest = (std::numeric_limits<sequence_value>::max)();
+                for(auto const* each: upstreams_)
+                    slowest = (std::min)(
+                        slowest,
+                        each->cursor_.load(std::memory_order_acquire));
+                upstream_until_ = slowest;
+                return c < slowest;
+            }
+        };   // consumer
+
+    private:
+        // Read-only after reserve and subscriptions
+        alignas(Alignment) size_type capacity_ {0};
+        sequence_value index_mask_ {0};
+        std::unique_ptr<T[]> pool_;
+        std::unique_ptr<std::atomic<sequence_value>[]> published_;
+        std::vector<std::unique_ptr<consumer>> consumers_;
+        // Producer-owned
+        alignas(Alignment) std::atomic<sequence_value> producer_ {0};
+        std::atomic<sequence_value> gating_cache_ {0};
+        std::atomic<size_type> blocks_count_ {0};
+        std::atomic<std::int64_t> blocked_time_ {0};
+
+    public:
+        broadcast_queue() noexcept = default;
+        broadcast_queue(broadcast_queue const&) = delete;
+        broadcast_queue& operator=(broadcast_queue const&) = delete;
+        broadcast_queue(size_type capacity) { reserve(capacity); }
+        explicit operator bool() noexcept { return !!pool_; }
+        size_type capacity() const noexcept { return capacity_; }
+        std::size_t consumers_count() const noexcept {
+            return consumers_.size();
+        }
+        size_type blocks_count() const noexcept {
+            return blocks_count_.load(std::memory_order_relaxed);
+        }
+        std::chrono::nanoseconds blocked_time() const noexcept {
+            return std::chrono::nanoseconds {
+                blocked_time_.load(std::memory_order_relaxed)};
+        }
+
+
+        void reserve(size_type capacity) {
+            capacity = nearest_power_of_2(capacity);
+            published_ =
+                std::make_unique<std::atomic<sequence_value>[]>(capacity);
+            for(size_type n = 0; n != capacity; ++n)
+                published_[n] = 0;
+            capacity_ = capacity;
+            index_mask_ = capacity - 1;
+            pool_ = std::make_unique<T[]>(capacity);
+        }
+
+
+        // Adds a consumer starting from the next claimed message
+        // which follows given upstream consumers,
+        // all consumers should subscribe before the first claim
+        consumer& subscribe(std::vector<consumer const*> upstreams = {}) {
+            auto const start = producer_.load(std::memory_order_relaxed);
+            consumers_.push_back(
+                std::make_unique<consumer>(*this, start, std::move(upstreams)));
+            gating_cache_.store(start, std::memory_order_relaxed);
+            return *consumers_.back();
+        }
+
+
+        T& operator[](sequence n) noexcept {
+            return pool_[n.value() & index_mask_];
+        }
+
+
+        T const& operator[](sequence n) const noexcept {
+            return pool_[n.value() & index_mask_];
+        }
+
+
+        // Waits until the slowest consumer frees a slot
+        template<typename W = yielding_wait>
+        sequence claim(W const& wait = W {}) noexcept {
+            if(!pool_)
+                return sequence {};
+
+            sequence const p {
+                producer_.fetch_add(1, std::memory_order_relaxed)};
+            if(fits(p.value()))
+                return p;
+
+            wait_for_room(wait, [this, p] { return fits(p.value()); });
+
+            return p;
+        }
+
+
+        // Takes the sequence only once its slot is free, so a timed out
+        // claim leaves no gap that would stall consumers
+        template<typename Rep, typename Period, typename W = yielding_wait>
+        sequence claim_for(std::chrono::duration<Rep, Period> const& duration,
+                           W const& wait = W {}) noexcept {
+            if(!pool_)
+                return sequence {};
+
+            auto const started = std::chrono::steady_clock::now();
+            auto const timed_out = [started, &duration] {
+                return std::chrono::steady_clock::now() - started >= duration;
+            };
+            bool blocked = false;
+            auto p = producer_.load(std::memory_order_relaxed);
+            for(;;) {
+                if(fits(p)) {
+                    if(producer_.compare_exchange_weak(
+                           p,
+                           p + 1,
+                           std::memory_order_relaxed))
+                        return sequence {p};
+                    continue;
+                }
+
+                if(timed_out())
+                    return sequence {};
+
+                if(!blocked) {
+                    blocks_count_.fetch_add(1, std::memory_order_relaxed);
+                    blocked = true;
+                }
+
+                wait.wait_until([this, &p, &timed_out] {
+                    p = producer_.load(std::memory_order_relaxed);
+                    return fits(p) || timed_out();
+                });
+            }
+        }
+
+
+        // Claims count contiguous sequences at once,
+        // count should not exceed capacity
+        template<typename W = yielding_wait>
+        sequence_range claim_n(size_type count, W const& wait = W {}) noexcept {
+            if(!pool_ || count <= 0 || count > capacity_)
+                return sequence_range {};
+
+            sequence const first {
+                producer_.fetch_add(count, std::memory_order_relaxed)};
+            sequence const last {first.value() + count};
+            if(fits(last.value() - 1))
+                return sequence_range {first, last};
+
+            wait_for_room(wait,
+                          [this, last] { return fits(last.value() - 1); });
+
+            return sequence_range {first, last};
+        }
+
+
+        void publish(sequence n) noexcept {
+            published_[n.value() & index_mask_].store(
+                n.value() + 1,
+                std::memory_order_release);
+        }
+
+
+        // Publishes sequences [first, last)
+        void publish_range(sequence first, sequence last) noexcept {
+            for(auto n = first.value(); n != last.value(); ++n)
+                published_[n & index_mask_].store(n + 1,
+                                                  std::memory_order_release);
+        }
+
+
+        void publish_range(sequence_range const& range) noexcept {
+            publish_range(range.first(), range.last());
+        }
+
+
+    private:
+        template<typename W, typename F>
+        void wait_for_room(W const& wait, F&& ready) noexcept {
+            blocks_count_.fetch_add(1, std::memory_order_relaxed);
+            auto const started = std::chrono::steady_clock::now();
+
+            wait.wait_until(ready);
+
+            auto const blocked = std::chrono::steady_clock::now() - started;
+            blocked_time_.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(blocked)
+                    .count(),
+                std::memory_order_relaxed);
+        }
+
+
+        // Rereads consumer cursors only when the cached minimum says
+        // there is no room for p, no consumers means no back pressure
+        bool fits(sequence_value p) noexcept {
+            if(p - gating_cache_.load(std::memory_order_acquire) < capacity_)
+                return true;
+            if(consumers_.empty())
+                return true;
+
+            auto slowest = p;
+            for(auto const& each: consumers_)
+                slowest = (std::min)(
+                    slowest,
+                    each->cursor_.load(std::memory_order_acquire));
+            gating_cache_.store(slowest, std::memory_order_release);
+            return p - slowest < capacity_;
+        }
+
+
+        // Rescans stamps only when the consumer's high-water mark is
+        // reached, the scan stops at the end of stamps cache line
+        bool published(sequence_value c, sequence_value& until) noexcept {
+            if(c < until)
+                return true;
+
+            constexpr auto stamps_per_line = sequence_value(
+                cacheline_size / sizeof(std::atomic<sequence_value>));
+            auto n = c;
+            do {
+                if(published_[n & index_mask_].load(std::memory_order_acquire)
+                   != n + 1)
+                    break;
+                ++n;
+            } while((n & (stamps_per_line - 1)) != 0);
+
+            until = n;
+            return n != c;
+        }
+
+
+        ring_span<T> span(sequence_value c, size_type count) noexcept {
+            auto const index = c & index_mask_;
+            auto const head = (std::min)(count, capacity_ - index);
+            return ring_span<T> {
+                std::span<T> {&pool_[index], std::size_t(head)},
+                std::span<T> {&pool_[0], std::size_t(count - head)},
+                sequence {c}};
+        }
+
+
+        static uint64_t nearest_power_of_2(uint64_t n) {
+            if(n < 2)
+                return 2;
+            n--;
+            n |= n >> 1;
+            n |= n >> 2;
+            n |= n >> 4;
+            n |= n >> 8;
+            n |= n >> 16;
+            n |= n >> 32;
+            n++;
+            return n;
+        }
+    };   // broadcast_queue
+
+
+}   // namespace hydra
@@ -0,0 +1,276 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+
+#include <hydra/cacheline.hpp>
+#include <hydra/sequence.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    // Bytes claimed for a record, position is the sequence of the record
+    struct claimed_bytes {
+        sequence position;
+        std::span<std::byte> bytes;
+
+        explicit operator bool() const noexcept { return !!position; }
+    };   // claimed_bytes
+
+
+    // Ring of variable-length records for several producers and a consumer.
+    // Each record is an 8-byte header followed by the payload, both aligned
+    // to 8 bytes; a record which does not fit before the end of the ring
+    // is preceded by a padding record. The consumer clears released records,
+    // so a header reads zero until it is published
+    template<std::size_t Alignment = cacheline_size>
+    class byte_queue {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = std::span<std::byte const>;
+
+        static_assert(is_valid_layout(Alignment));
+
+        static constexpr size_type record_alignment = 8;
+        static constexpr size_type header_size = 8;
+        // Record lengths, padding included, are kept in 32 bits
+        static constexpr size_type max_capacity = size_type(1) << 32;
+
+    private:
+        using sequence_value = sequence::value_type;
+        using word = std::uint64_t;
+
+        static constexpr word published_flag = word(1) << 63;
+        static constexpr word padding_flag = word(1) << 62;
+        static constexpr word length_mask = 0xFFFFFFFF;
+        static_assert(word(max_capacity - 1) == length_mask);
+
+        // Read-only after reserve
+        alignas(Alignment) size_type capacity_ {0};
+        sequence_value index_mask_ {0};
+        std::unique_ptr<word[]> words_;
+        // Producer-owned
+        alignas(Alignment) std::atomic<sequence_value> producer_ {0};
+        std::atomic<sequence_value> consumer_cache_ {0};
+        std::atomic<size_type> blocks_count_ {0};
+        // Consumer-owned
+        alignas(Alignment) std::atomic<sequence_value> consumer_ {0};
+
+    public:
+        byte_queue() noexcept = default;
+        byte_queue(byte_queue const&) = delete;
+        byte_queue& operator=(byte_queue const&) = delete;
+        byte_queue(size_type capacity) { reserve(capacity); }
+        explicit operator bool() noexcept { return !!words_; }
+        size_type capacity() const noexcept { return capacity_; }
+        size_type blocks_count() const noexcept {
+            return blocks_count_.load(std::memory_order_relaxed);
+        }
+        // Bytes claimed and not yet released, padding included
+        size_type size() const noexcept {
+            return producer_.load(std::memory_order_relaxed)
+                   - consumer_.load(std::memory_order_relaxed);
+        }
+
+
+        // Largest payload of a single record: a record of half the ring
+        // with the padding before it fits at any producer index
+        size_type max_record_size() const noexcept {
+            return capacity_ == 0 ? 0 : capacity_ / 2 - header_size;
+        }
+
+
+        // Capacity in bytes rounded up to a power of two,
+        // no more than max_capacity
+        void reserve(size_type capacity) {
+            capacity = nearest_power_of_2((std::min)(capacity, max_capacity));
+            if(capacity < 2 * record_alignment)
+                capacity = 2 * record_alignment;
+            words_ =
+                std::make_unique<word[]>(std::size_t(capacity / sizeof(word)));
+            capacity_ = capacity;
+            index_mask_ = capacity - 1;
+        }
+
+
+        // Waits for a contiguous region of size bytes with the given strategy
+        template<typename W = yielding_wait>
+        claimed_bytes claim(size_type size, W const& wait = W {}) noexcept {
+            return claim_region(size, wait, [] { return false; });
+        }
+
+
+        template<typename Rep, typename Period, typename W = yielding_wait>
+        claimed_bytes
+            claim_for(size_type size,
+                      std::chrono::duration<Rep, Period> const& duration,
+                      W const& wait = W {}) noexcept {
+            auto const started = std::chrono::steady_clock::now();
+            return claim_region(size, wait, [started, &duration] {
+                return std::chrono::steady_clock::now() - started >= duration;
+            });
+        }
+
+
+        void publish(claimed_bytes const& claimed) noexcept {
+            header(claimed.position.value())
+                .store(published_flag | word(claimed.bytes.size()),
+                       std::memory_order_release);
+        }
+
+
+        // Skips padding records, returns position of the published record
+        sequence try_fetch() noexcept {
+            if(!words_)
+                return sequence {};
+
+            for(;;) {
+                auto const c = consumer_.load(std::memory_order_relaxed);
+                auto const h = header(c).load(std::memory_order_acquire);
+                if((h & published_flag) == 0)
+                    return sequence {};
+                if((h & padding_flag) == 0)
+                    return sequence {c};
+                release(c, sequence_value(h & length_mask));
+            }
+        }
+
+
+        bool ready() noexcept { return !!try_fetch(); }
+
+
+        // Payload of the published record at position n
+        std::span<std::byte const> operator[](sequence n) noexcept {
+            auto const h =
+                header(n.value()).load(std::memory_order_relaxed);
+            return std::span<std::byte const> {
+                payload(n.value()),
+                std::size_t(h & length_mask)};
+        }
+
+
+        // Clears the fetched record and releases its bytes to producers
+        void fetched() noexcept {
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            auto const h = header(c).load(std::memory_order_relaxed);
+            release(c, record_size(sequence_value(h & length_mask)));
+        }
+
+
+    private:
+        // Claims padding up to the end of the ring with the record
+        // when the record does not fit before the end
+        template<typename W, typename F>
+        claimed_bytes claim_region(size_type size,
+                                   W const& wait,
+                                   F&& timed_out) noexcept {
+            if(!words_ || size < 0 || size > max_record_size())
+                return claimed_bytes {};
+
+            auto const total = record_size(size);
+            auto p = producer_.load(std::memory_order_relaxed);
+            sequence_value padding = 0;
+            for(;;) {
+                auto const index = p & index_mask_;
+                padding = index + total > capacity_ ? capacity_ - index : 0;
+                auto const next = p + padding + total;
+                if(!fits(next)) {
+                    blocks_count_.fetch_add(1, std::memory_order_relaxed);
+                    wait.wait_until([this, next, &timed_out] {
+                        return fits(next) || timed_out();
+                    });
+                    if(!fits(next) && timed_out())
+                        return claimed_bytes {};
+                    p = producer_.load(std::memory_order_relaxed);
+                    continue;
+                }
+                if(producer_.compare_exchange_weak(p,
+                                                   next,
+                                                   std::memory_order_relaxed,
+                                                   std::memory_order_relaxed))
+                    break;
+            }
+
+            if(padding != 0)
+                header(p).store(published_flag | padding_flag | word(padding),
+                                std::memory_order_release);
+
+            auto const position = p + padding;
+            return claimed_bytes {
+                sequence {position},
+                std::span<std::byte> {payload(position), std::size_t(size)}};
+        }
+
+
+        static constexpr size_type record_size(size_type size) noexcept {
+            return header_size
+                   + (size + record_alignment - 1) / record_alignment
+                         * record_alignment;
+        }
+
+
+        std::atomic_ref<word> header(sequence_value n) noexcept {
+            return std::atomic_ref<word> {
+                words_[std::size_t((n & index_mask_) / sizeof(word))]};
+        }
+
+
+        std::byte* payload(sequence_value n) noexcept {
+            return reinterpret_cast<std::byte*>(words_.get())
+                   + (n & index_mask_) + header_size;
+        }
+
+
+        void release(sequence_value c, size_type total) noexcept {
+            auto* const record =
+                reinterpret_cast<std::byte*>(words_.get()) + (c & index_mask_);
+            std::memset(record + header_size,
+                        0,
+                        std::size_t(total - header_size));
+            header(c).store(0, std::memory_order_relaxed);
+            consumer_.store(c + total, std::memory_order_release);
+        }
+
+
+        // Rereads consumer cursor only when the cached one says
+        // there is no room for bytes up to next
+        bool fits(sequence_value next) noexcept {
+            if(next - consumer_cache_.load(std::memory_order_acquire)
+               <= capacity_)
+                return true;
+            auto const c = consumer_.load(std::memory_order_acquire);
+            consumer_cache_.store(c, std::memory_order_release);
+            return next - c <= capacity_;
+        }
+
+
+        static uint64_t nearest_power_of_2(uint64_t n) {
+            if(n < 2)
+                return 2;
+            n--;
+            n |= n >> 1;
+            n |= n >> 2;
+            n |= n >> 4;
+            n |= n >> 8;
+            n |= n >> 16;
+            n |= n >> 32;
+            n++;
+            return n;
+        }
+    };   // byte_queue
+
+
+}   // namespace hydra
@@ -0,0 +1,32 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+namespace hydra {
+
+
+    // Size of a single cache line
+    static constexpr std::size_t cacheline_size = 64;
+
+    // Adjacent-line prefetchers fetch cache lines in 128-byte pairs,
+    // so fields isolated at this granularity don't share prefetch traffic
+    static constexpr std::size_t cacheline_pair_size = 128;
+
+    // Queue fields are packed next to each other without isolation
+    static constexpr std::size_t packed_layout = alignof(std::int64_t);
+
+
+    constexpr bool is_valid_layout(std::size_t alignment) noexcept {
+        return alignment >= packed_layout
+               && (alignment & (alignment - 1)) == 0;
+    }
+
+
+}   // namespace hydra
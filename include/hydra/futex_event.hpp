@@ -7,6 +7,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <climits>
 
 #if defined(_WIN32)
 
@@ -47,24 +48,76 @@
 namespace hydra {
 
 
-    class futex_event {
+    enum class futex_scope {
+        // Waiters and notifiers share the address space
+        process_private,
+        // Event lives in memory shared between processes, Linux only
+        process_shared
+    };   // futex_scope
+
+
+    // Waiters announce themselves before sleeping, so notifications
+    // enter the kernel only when somebody is actually parked
+    template<futex_scope Scope>
+    class basic_futex_event {
     private:
+#if defined(_WIN32)
+        static_assert(Scope == futex_scope::process_private,
+                      "WaitOnAddress does not wake other processes");
+#elif defined(__linux__)
+        static constexpr int wake_op = Scope == futex_scope::process_private
+                                           ? FUTEX_WAKE_PRIVATE
+                                           : FUTEX_WAKE;
+        static constexpr int wait_op = Scope == futex_scope::process_private
+                                           ? FUTEX_WAIT_PRIVATE
+                                           : FUTEX_WAIT;
+#endif
+
         std::atomic_uint32_t value_;
+        std::atomic_uint32_t waiters_ {0};
+        std::atomic_uint64_t syscalls_count_ {0};
 
     public:
-        futex_event() noexcept = default;
-        futex_event(futex_event const&) = delete;
-        futex_event& operator=(futex_event const&) = delete;
+        basic_futex_event() noexcept = default;
+        basic_futex_event(basic_futex_event const&) = delete;
+        basic_futex_event& operator=(basic_futex_event const&) = delete;
+
+        // Number of notifications, to be passed to wait
+        std::uint32_t value() const noexcept {
+            return value_.load(std::memory_order_acquire);
+        }
+
+
+        // Number of waiters parked or about to park
+        std::uint32_t waiters() const noexcept {
+            return waiters_.load(std::memory_order_relaxed);
+        }
+
+
+        // Number of wake syscalls made by notifications
+        std::uint64_t syscalls_count() const noexcept {
+            return syscalls_count_.load(std::memory_order_relaxed);
+        }
+
+
+        void clear_syscalls_count() noexcept {
+            syscalls_count_.store(0, std::memory_order_relaxed);
+        }
 
 
         void notify_one() noexcept {
-            value_.fetch_add(1, std::memory_order_relaxed);
+            // Pairs with increment of waiters in wait: either notifier sees
+            // the waiter or the waiter sees the new value in the kernel
+            value_.fetch_add(1, std::memory_order_seq_cst);
+            if(waiters_.load(std::memory_order_seq_cst) == 0)
+                return;
+            syscalls_count_.fetch_add(1, std::memory_order_relaxed);
 #if defined(_WIN32)
             WakeByAddressSingle(&value_);
 #elif defined(__linux__)
             syscall(SYS_futex,
                     &value_,
-                    FUTEX_WAKE_PRIVATE,
+                    wake_op,
                     1,
                     nullptr,
                     nullptr,
@@ -73,7 +126,27 @@ namespace hydra {
         }
 
 
+        void notify_all() noexcept {
+            value_.fetch_add(1, std::memory_order_seq_cst);
+            if(waiters_.load(std::memory_order_seq_cst) == 0)
+                return;
+            syscalls_count_.fetch_add(1, std::memory_order_relaxed);
+#if defined(_WIN32)
+            WakeByAddressAll(&value_);
+#elif defined(__linux__)
+            syscall(SYS_futex,
+                    &value_,
+                    wake_op,
+                    INT_MAX,
+                    nullptr,
+                    nullptr,
+                    0);
+#endif
+        }
+
+
         void wait(std::uint32_t events_processed) noexcept {
+            waiters_.fetch_add(1, std::memory_order_seq_cst);
 #if defined(_WIN32)
             WaitOnAddress(&value_,
                           &events_processed,
@@ -82,12 +155,13 @@ namespace hydra {
 #elif defined(__linux__)
             syscall(SYS_futex,
                     &value_,
-                    FUTEX_WAIT_PRIVATE,
+                    wait_op,
                     events_processed,
                     nullptr,
                     nullptr,
                     0);
 #endif
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
         }
 
 
@@ -95,12 +169,13 @@ namespace hydra {
         void wait(std::uint32_t events_processed,
                   std::chrono::duration<Rep, Period> timeout) noexcept {
             using namespace std::chrono;
+            waiters_.fetch_add(1, std::memory_order_seq_cst);
 #if defined(_WIN32)
             auto const ms = duration_cast<milliseconds>(timeout);
             WaitOnAddress(&value_,
                           &events_processed,
                           sizeof(events_processed),
-                          DWORD(timeout.count()));
+                          DWORD(ms.count()));
 #elif defined(__linux__)
             auto const secs = duration_cast<seconds>(timeout);
             auto const ns = duration_cast<nanoseconds>(timeout - secs);
@@ -108,14 +183,19 @@ namespace hydra {
                 timespec {std::time_t(secs.count()), long(ns.count())};
             syscall(SYS_futex,
                     &value_,
-                    FUTEX_WAIT_PRIVATE,
+                    wait_op,
                     events_processed,
                     &ts,
                     nullptr,
                     0);
 #endif
+            waiters_.fetch_sub(1, std::memory_order_relaxed);
         }
 
-    };   // futex_event
+    };   // basic_futex_event
+
+
+    using futex_event = basic_futex_event<futex_scope::process_private>;
+    using shared_futex_event = basic_futex_event<futex_scope::process_shared>;
 
 }   // namespace hydra
@@ -0,0 +1,582 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#if defined(__linux__)
+
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+
+#else
+
+#    error Journal queue is supported on Linux only
+
+#endif
+
+#include <hydra/cacheline.hpp>
+#include <hydra/futex_event.hpp>
+#include <hydra/sequence.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    struct journal_options {
+        std::filesystem::path directory;
+        // Messages per file, rounded up to a power of 2
+        sequence::value_type file_messages {1 << 20};
+        // Claims wait for retire once the journal has this many files
+        std::size_t max_files {4096};
+        // Consumer gets records only once they are on disk, syncing
+        // them itself when the sync thread is behind
+        bool durable_delivery {false};
+    };   // journal_options
+
+
+    // Queue for several producers and a consumer whose messages are
+    // written to rolling memory-mapped files. A record is published by
+    // its stamp, so after a restart the journal continues from the first
+    // unpublished record and readers replay it from any sequence.
+    // Durability is up to sync, called directly or by the sync thread;
+    // old files are unmapped and deleted by retire
+    template<typename T>
+    class journal_queue {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = T;
+
+        static_assert(std::is_trivially_copyable_v<T>);
+
+    private:
+        using sequence_value = sequence::value_type;
+
+        struct file_header {
+            static constexpr std::uint64_t magic_value = 0x4c4e524a41524459;
+            static constexpr std::uint32_t current_version = 1;
+
+            std::uint64_t magic;
+            std::uint32_t version;
+            std::uint32_t element_size;
+            std::uint64_t file_messages;
+            std::uint64_t first_sequence;
+        };   // file_header
+
+        struct record {
+            // Sequence plus one once published, zero before
+            sequence_value stamp;
+            T value;
+        };   // record
+
+        static constexpr std::size_t header_size = 4096;
+
+        // Read-only after open
+        alignas(cacheline_size) size_type file_messages_ {0};
+        sequence_value file_mask_ {0};
+        std::size_t max_files_ {0};
+        // Sequences of max_files files starting from base
+        sequence_value window_ {0};
+        bool durable_delivery_ {false};
+        // Files are kept in a ring of max_files slots
+        std::unique_ptr<std::atomic<record*>[]> files_;
+        std::filesystem::path directory_;
+        // Moved forward by retire
+        std::atomic<sequence_value> base_ {0};
+        std::mutex rolling_;
+        futex_event retired_;
+        // Producer-owned
+        alignas(cacheline_size) std::atomic<sequence_value> producer_ {0};
+        // Consumer-owned
+        alignas(cacheline_size) std::atomic<sequence_value> consumer_ {0};
+        // Syncing thread
+        alignas(cacheline_size) std::atomic<sequence_value> durable_ {0};
+        std::mutex syncing_;
+        std::atomic<bool> notify_sync_ {false};
+        futex_event published_;
+        std::atomic_flag stopping_ {};
+        std::thread syncer_;
+
+    public:
+        journal_queue() noexcept = default;
+        journal_queue(journal_queue const&) = delete;
+        journal_queue& operator=(journal_queue const&) = delete;
+
+
+        ~journal_queue() {
+            stop_syncing();
+            if(!files_)
+                return;
+            for(std::size_t i = 0; i != max_files_; ++i) {
+                auto* const file = files_[i].load(std::memory_order_relaxed);
+                if(file != nullptr)
+                    munmap(to_header(file), file_bytes());
+            }
+        }
+
+
+        // Maps existing files of the directory and continues after
+        // the last published record; records claimed but not published
+        // before a crash are dropped
+        bool open(journal_options const& options) {
+            if(files_ || options.max_files == 0)
+                return false;
+
+            std::error_code error;
+            std::filesystem::create_directories(options.directory, error);
+            if(error)
+                return false;
+
+            directory_ = options.directory;
+            file_messages_ = size_type(std::bit_ceil(
+                std::uint64_t((std::max)(options.file_messages,
+                                         size_type(2)))));
+            file_mask_ = file_messages_ - 1;
+            max_files_ = options.max_files;
+            window_ = sequence_value(max_files_) * file_messages_;
+            durable_delivery_ = options.durable_delivery;
+            files_ = std::make_unique<std::atomic<record*>[]>(max_files_);
+
+            // Files should follow each other without gaps, otherwise
+            // records after a gap would be taken for published ones
+            // once producers reach them
+            auto const existing = existing_files();
+            auto const base = existing.empty() ? 0 : existing.front();
+            base_.store(base, std::memory_order_relaxed);
+            bool valid = existing.size() <= max_files_
+                         && (base & file_mask_) == 0;
+            for(std::size_t i = 0; valid && i != existing.size(); ++i)
+                valid = existing[i]
+                            == base + sequence_value(i) * file_messages_
+                        && map_file(existing[i], false);
+            if(!valid) {
+                close_files();
+                return false;
+            }
+
+            auto const end = recover(
+                base + sequence_value(existing.size()) * file_messages_);
+            producer_.store(end, std::memory_order_relaxed);
+            consumer_.store(end, std::memory_order_relaxed);
+            durable_.store(end, std::memory_order_relaxed);
+            return true;
+        }
+
+
+        explicit operator bool() const noexcept { return !!files_; }
+        size_type file_messages() const noexcept { return file_messages_; }
+        // Sequence of the oldest record in the journal
+        sequence first() const noexcept {
+            return sequence {base_.load(std::memory_order_acquire)};
+        }
+        // Records before this sequence are on disk
+        sequence durable() const noexcept {
+            return sequence {durable_.load(std::memory_order_acquire)};
+        }
+
+
+        size_type size() const noexcept {
+            return producer_.load(std::memory_order_relaxed)
+                   - consumer_.load(std::memory_order_relaxed);
+        }
+
+
+        // Waits for retire with the given strategy once max_files
+        // are in use; fails without claiming when a file can not be
+        // created
+        template<typename W = yielding_wait>
+        sequence claim(W const& wait = W {}) noexcept {
+            if(!files_)
+                return sequence {};
+            auto p = producer_.load(std::memory_order_relaxed);
+            for(;;) {
+                if(!in_window(p)) {
+                    wait.wait_until(retired_, [this, &p] {
+                        p = producer_.load(std::memory_order_relaxed);
+                        return in_window(p);
+                    });
+                    continue;
+                }
+                if(locate(p) == nullptr)
+                    return sequence {};
+                if(producer_.compare_exchange_weak(p,
+                                                   p + 1,
+                                                   std::memory_order_relaxed))
+                    return sequence {p};
+            }
+        }
+
+
+        // Fails when max_files are in use or a file can not be created
+        sequence try_claim() noexcept {
+            if(!files_)
+                return sequence {};
+            auto p = producer_.load(std::memory_order_relaxed);
+            while(in_window(p) && locate(p) != nullptr)
+                if(producer_.compare_exchange_weak(p,
+                                                   p + 1,
+                                                   std::memory_order_relaxed))
+                    return sequence {p};
+            return sequence {};
+        }
+
+
+        T& operator[](sequence n) noexcept {
+            return loaded(n.value())->value;
+        }
+
+
+        T const& operator[](sequence n) const noexcept {
+            return loaded(n.value())->value;
+        }
+
+
+        void publish(sequence n) noexcept {
+            std::atomic_ref<sequence_value> {loaded(n.value())->stamp}
+                .store(n.value() + 1, std::memory_order_release);
+            if(notify_sync_.load(std::memory_order_relaxed))
+                published_.notify_one();
+        }
+
+
+        sequence try_fetch() noexcept {
+            if(!files_)
+                return sequence {};
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            if(!published(c))
+                return sequence {};
+            if(durable_delivery_
+               && durable_.load(std::memory_order_acquire) <= c)
+                sync();
+            return sequence {c};
+        }
+
+
+        // Whether the message at consumer cursor is published
+        bool ready() noexcept { return !!try_fetch(); }
+
+
+        void fetched() noexcept {
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            consumer_.store(c + 1, std::memory_order_release);
+        }
+
+
+        // Replays published records from any sequence, independently
+        // of the consumer and of other readers
+        class reader {
+        public:
+            reader(journal_queue const& journal, sequence from) noexcept
+                : journal_ {&journal}, cursor_ {from.value()} {}
+
+            sequence cursor() const noexcept { return sequence {cursor_}; }
+
+            sequence try_fetch() const noexcept {
+                if(!journal_->published(cursor_))
+                    return sequence {};
+                return sequence {cursor_};
+            }
+
+            T const& operator[](sequence n) const noexcept {
+                return (*journal_)[n];
+            }
+
+            void fetched() noexcept { ++cursor_; }
+
+        private:
+            journal_queue const* journal_;
+            sequence_value cursor_;
+        };   // reader
+
+
+        reader replay(sequence from) const noexcept {
+            return reader {*this,
+                           sequence {(std::max)(from.value(),
+                                                first().value())}};
+        }
+
+
+        // Unmaps and deletes files whose records all precede the given
+        // sequence and are both fetched and durable, wakes producers
+        // waiting for room; readers should not replay retired records.
+        // Returns the new first sequence
+        sequence retire(sequence before) {
+            if(!files_)
+                return sequence {};
+            std::lock_guard lock {rolling_};
+            auto const limit =
+                (std::min)({before.value(),
+                            consumer_.load(std::memory_order_acquire),
+                            durable_.load(std::memory_order_acquire)});
+            auto base = base_.load(std::memory_order_relaxed);
+            if(base + file_messages_ > limit)
+                return sequence {base};
+            for(; base + file_messages_ <= limit; base += file_messages_) {
+                auto* const file = files_[slot_of(base)].exchange(
+                    nullptr, std::memory_order_acq_rel);
+                if(file != nullptr)
+                    munmap(to_header(file), file_bytes());
+                std::error_code error;
+                std::filesystem::remove(file_path(base), error);
+                // Slot is cleared before producers may reuse it
+                base_.store(base + file_messages_, std::memory_order_release);
+            }
+            retired_.notify_all();
+            return sequence {base};
+        }
+
+
+        // Flushes published records following the durable cursor to disk
+        // with a msync per file, returns the number of records flushed
+        size_type sync() noexcept {
+            std::lock_guard lock {syncing_};
+            auto const from = durable_.load(std::memory_order_relaxed);
+            auto until = from;
+            while(published(until))
+                ++until;
+            if(until == from)
+                return 0;
+
+            for(auto n = from; n != until;) {
+                auto const file_end = (n | file_mask_) + 1;
+                auto const last = (std::min)(until, file_end);
+                flush(n, last);
+                n = last;
+            }
+            durable_.store(until, std::memory_order_release);
+            return until - from;
+        }
+
+
+        // Syncs each batch as soon as it is published with zero period,
+        // otherwise syncs every period
+        bool start_syncing(std::chrono::nanoseconds period = {}) {
+            if(syncer_.joinable() || !files_)
+                return false;
+            notify_sync_.store(period.count() == 0,
+                               std::memory_order_relaxed);
+            syncer_ = std::thread {[this, period] {
+                while(!stopping_.test(std::memory_order_acquire)) {
+                    if(period.count() == 0)
+                        blocking_wait {}.wait_until(published_, [this] {
+                            return published(durable_.load(
+                                       std::memory_order_relaxed))
+                                   || stopping_.test(
+                                       std::memory_order_acquire);
+                        });
+                    else
+                        std::this_thread::sleep_for(period);
+                    sync();
+                }
+                sync();
+                stopping_.clear(std::memory_order_relaxed);
+            }};
+            return true;
+        }
+
+
+        // Flushes what is published before returning
+        void stop_syncing() noexcept {
+            if(!syncer_.joinable()
+               || stopping_.test_and_set(std::memory_order_release))
+                return;
+            published_.notify_one();
+            syncer_.join();
+            notify_sync_.store(false, std::memory_order_relaxed);
+        }
+
+    private:
+        std::size_t file_bytes() const noexcept {
+            return header_size + std::size_t(file_messages_) * sizeof(record);
+        }
+
+
+        std::size_t slot_of(sequence_value n) const noexcept {
+            return std::size_t(n / file_messages_) % max_files_;
+        }
+
+
+        bool in_window(sequence_value n) const noexcept {
+            return n - base_.load(std::memory_order_acquire) < window_;
+        }
+
+
+        static void* to_header(record* file) noexcept {
+            return reinterpret_cast<std::byte*>(file) - header_size;
+        }
+
+
+        record* loaded(sequence_value n) const noexcept {
+            auto const base = base_.load(std::memory_order_acquire);
+            if(n < base || n - base >= window_)
+                return nullptr;
+            auto* const file =
+                files_[slot_of(n)].load(std::memory_order_acquire);
+            return file == nullptr ? nullptr : file + (n & file_mask_);
+        }
+
+
+        // Maps the file of n when it does not exist yet
+        record* locate(sequence_value n) noexcept {
+            auto* const found = loaded(n);
+            if(found != nullptr)
+                return found;
+            std::lock_guard lock {rolling_};
+            if(!in_window(n) || !map_file(n & ~file_mask_, true))
+                return nullptr;
+            return loaded(n);
+        }
+
+
+        bool published(sequence_value n) const noexcept {
+            auto* const found = loaded(n);
+            return found != nullptr
+                   && std::atomic_ref<sequence_value> {found->stamp}
+                              .load(std::memory_order_acquire)
+                          == n + 1;
+        }
+
+
+        std::filesystem::path file_path(sequence_value first) const {
+            char name[32];
+            std::snprintf(name,
+                          sizeof(name),
+                          "%020lld.journal",
+                          static_cast<long long>(first));
+            return directory_ / name;
+        }
+
+
+        std::vector<sequence_value> existing_files() const {
+            std::vector<sequence_value> firsts;
+            std::error_code error;
+            for(auto const& entry:
+                std::filesystem::directory_iterator {directory_, error}) {
+                auto const stem = entry.path().stem().string();
+                sequence_value first = 0;
+                auto const parsed = std::from_chars(
+                    stem.data(), stem.data() + stem.size(), first);
+                if(entry.path().extension() == ".journal"
+                   && parsed.ec == std::errc {}
+                   && parsed.ptr == stem.data() + stem.size())
+                    firsts.push_back(first);
+            }
+            std::sort(firsts.begin(), firsts.end());
+            return firsts;
+        }
+
+
+        // Creates the file afresh when asked to, validates its size
+        // and header otherwise
+        bool map_file(sequence_value first, bool create) noexcept {
+            auto const index = slot_of(first);
+            if(files_[index].load(std::memory_order_relaxed) != nullptr)
+                return true;
+
+            auto const path = file_path(first);
+            int const fd = create
+                               ? ::open(path.c_str(),
+                                        O_RDWR | O_CREAT | O_TRUNC,
+                                        0644)
+                               : ::open(path.c_str(), O_RDWR);
+            if(fd == -1)
+                return false;
+            auto const bytes = file_bytes();
+            struct stat status;
+            bool const sized =
+                create ? ftruncate(fd, off_t(bytes)) == 0
+                       : fstat(fd, &status) == 0
+                             && std::size_t(status.st_size) == bytes;
+            if(!sized) {
+                ::close(fd);
+                return false;
+            }
+            void* const p = mmap(nullptr,
+                                 bytes,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_SHARED,
+                                 fd,
+                                 0);
+            ::close(fd);
+            if(p == MAP_FAILED)
+                return false;
+
+            auto* const header = static_cast<file_header*>(p);
+            if(create) {
+                *header = file_header {file_header::magic_value,
+                                       file_header::current_version,
+                                       std::uint32_t(sizeof(T)),
+                                       std::uint64_t(file_messages_),
+                                       std::uint64_t(first)};
+                msync(p, header_size, MS_SYNC);
+            } else if(header->magic != file_header::magic_value
+                      || header->version != file_header::current_version
+                      || header->element_size != sizeof(T)
+                      || header->file_messages
+                             != std::uint64_t(file_messages_)
+                      || header->first_sequence != std::uint64_t(first)) {
+                munmap(p, bytes);
+                return false;
+            }
+
+            auto* const records = reinterpret_cast<record*>(
+                static_cast<std::byte*>(p) + header_size);
+            files_[index].store(records, std::memory_order_release);
+            return true;
+        }
+
+
+        void close_files() noexcept {
+            for(std::size_t i = 0; i != max_files_; ++i) {
+                auto* const file = files_[i].exchange(nullptr);
+                if(file != nullptr)
+                    munmap(to_header(file), file_bytes());
+            }
+            files_.reset();
+        }
+
+
+        // Finds the first unpublished record and clears stamps after it
+        // up to the end of mapped files, so records written past a hole
+        // are not taken for new ones
+        sequence_value recover(sequence_value files_end) noexcept {
+            auto end = base_.load(std::memory_order_relaxed);
+            while(published(end))
+                ++end;
+            for(auto n = end; n < files_end; ++n)
+                loaded(n)->stamp = 0;
+            return end;
+        }
+
+
+        void flush(sequence_value first, sequence_value last) noexcept {
+            auto const page = std::uintptr_t(sysconf(_SC_PAGESIZE));
+            auto const from = std::uintptr_t(loaded(first));
+            auto const to = std::uintptr_t(loaded(last - 1) + 1);
+            auto const aligned = from / page * page;
+            msync(reinterpret_cast<void*>(aligned), to - aligned, MS_SYNC);
+        }
+    };   // journal_queue
+
+
+}   // namespace hydra
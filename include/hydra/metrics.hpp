@@ -0,0 +1,131 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include <hydra/cacheline.hpp>
+
+
+namespace hydra {
+
+
+    // Counters of a queue and its consumer at some moment. Every
+    // counter is exact, but they are read one after another, so
+    // processed may lag behind published read a moment earlier
+    struct metrics_snapshot {
+        std::uint64_t published {0};
+        std::uint64_t processed {0};
+        std::uint64_t batches {0};
+        std::uint64_t max_batch {0};
+        std::uint64_t depth_high_water {0};
+        std::uint64_t claims_blocked {0};
+        std::chrono::nanoseconds blocked_time {0};
+        std::uint64_t wakeups {0};
+        std::uint64_t wake_syscalls {0};
+        std::chrono::nanoseconds busy_time {0};
+
+        double mean_batch() const noexcept {
+            return batches != 0 ? double(processed) / double(batches) : 0.;
+        }
+    };   // metrics_snapshot
+
+
+    // Each thread gets its own shard, threads beyond shards_count
+    // share them round robin
+    inline std::size_t this_thread_shard() noexcept {
+        static std::atomic<std::size_t> next {0};
+        thread_local std::size_t const shard =
+            next.fetch_add(1, std::memory_order_relaxed);
+        return shard;
+    }
+
+
+    // Always-on counters: producers add to their own cacheline,
+    // the consumer keeps its counters on another one, and snapshot
+    // only reads them, so scraping from a monitoring thread does not
+    // contend with writers
+    class metrics {
+    public:
+        static constexpr std::size_t shards_count = 16;
+
+    private:
+        struct alignas(cacheline_size) shard {
+            std::atomic<std::uint64_t> published {0};
+            std::atomic<std::uint64_t> wakeups {0};
+        };   // shard
+
+        shard shards_[shards_count];
+        // Consumer-owned, single writer
+        alignas(cacheline_size) std::atomic<std::uint64_t> processed_ {0};
+        std::atomic<std::uint64_t> batches_ {0};
+        std::atomic<std::uint64_t> max_batch_ {0};
+        std::atomic<std::uint64_t> depth_high_water_ {0};
+        std::atomic<std::int64_t> busy_time_ {0};
+
+    public:
+        metrics() noexcept = default;
+        metrics(metrics const&) = delete;
+        metrics& operator=(metrics const&) = delete;
+
+
+        // Called by producers, each notification counts as a wakeup
+        void published(std::uint64_t count, bool notified) noexcept {
+            auto& s = shards_[this_thread_shard() % shards_count];
+            s.published.fetch_add(count, std::memory_order_relaxed);
+            if(notified)
+                s.wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        // Called by producers notifying the consumer without publishing
+        void woke() noexcept {
+            auto& s = shards_[this_thread_shard() % shards_count];
+            s.wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+
+
+        // Called by the consumer only: messages claimed and not yet
+        // fetched when the batch started, messages handled and time
+        // spent handling them
+        void batch_done(std::uint64_t depth,
+                        std::uint64_t size,
+                        std::chrono::nanoseconds busy) noexcept {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            processed_.store(processed_.load(relaxed) + size, relaxed);
+            batches_.store(batches_.load(relaxed) + 1, relaxed);
+            if(size > max_batch_.load(relaxed))
+                max_batch_.store(size, relaxed);
+            if(depth > depth_high_water_.load(relaxed))
+                depth_high_water_.store(depth, relaxed);
+            busy_time_.store(busy_time_.load(relaxed) + busy.count(),
+                             relaxed);
+        }
+
+
+        // Claim and syscall counters belong to the queue and the event,
+        // their owner fills them in
+        metrics_snapshot snapshot() const noexcept {
+            constexpr auto relaxed = std::memory_order_relaxed;
+            metrics_snapshot s;
+            for(auto const& each: shards_) {
+                s.published += each.published.load(relaxed);
+                s.wakeups += each.wakeups.load(relaxed);
+            }
+            s.processed = processed_.load(relaxed);
+            s.batches = batches_.load(relaxed);
+            s.max_batch = max_batch_.load(relaxed);
+            s.depth_high_water = depth_high_water_.load(relaxed);
+            s.busy_time = std::chrono::nanoseconds {busy_time_.load(relaxed)};
+            return s;
+        }
+    };   // metrics
+
+
+}   // namespace hydra
@@ -0,0 +1,372 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include <hydra/cacheline.hpp>
+#include <hydra/ring_span.hpp>
+#include <hydra/sequence.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    // Bounded queue with per-slot stamps (D. Vyukov): slot of sequence n
+    // is free for n when stamp is n, published when stamp is n + 1 and
+    // released for the next lap when stamp is n + capacity.
+    // Consumers own fetched messages until they release them by
+    // fetched(n), so several consumers drain the queue concurrently
+    template<typename T, std::size_t Alignment = cacheline_size>
+    class mpmc_queue {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = T;
+
+        static_assert(is_valid_layout(Alignment));
+
+    private:
+        using sequence_value = sequence::value_type;
+
+        // Read-only after reserve
+        alignas(Alignment) size_type capacity_ {0};
+        sequence_value index_mask_ {0};
+        std::unique_ptr<T[]> pool_;
+        std::unique_ptr<std::atomic<sequence_value>[]> stamps_;
+        // Producer-owned
+        alignas(Alignment) std::atomic<sequence_value> producer_ {0};
+        std::atomic<size_type> blocks_count_ {0};
+        std::atomic<std::int64_t> blocked_time_ {0};
+        // Consumer-owned
+        alignas(Alignment) std::atomic<sequence_value> consumer_ {0};
+
+    public:
+        mpmc_queue() noexcept = default;
+        mpmc_queue(mpmc_queue const&) = delete;
+        mpmc_queue& operator=(mpmc_queue const&) = delete;
+        mpmc_queue(size_type capacity) { reserve(capacity); }
+        explicit operator bool() noexcept { return !!pool_; }
+        size_type capacity() const noexcept { return capacity_; }
+
+
+        mpmc_queue(mpmc_queue&& other) noexcept
+            : capacity_ {other.capacity_},
+              index_mask_ {other.index_mask_},
+              pool_ {std::move(other.pool_)},
+              stamps_ {std::move(other.stamps_)},
+              producer_ {other.producer_.load(std::memory_order_relaxed)},
+              consumer_ {other.consumer_.load(std::memory_order_relaxed)} {
+            other.capacity_ = 0;
+            other.producer_.store(0, std::memory_order_relaxed);
+            other.consumer_.store(0, std::memory_order_relaxed);
+        }
+
+
+        mpmc_queue& operator=(mpmc_queue&& other) noexcept {
+            capacity_ = other.capacity_;
+            other.capacity_ = 0;
+            index_mask_ = other.index_mask_;
+            pool_ = std::move(other.pool_);
+            stamps_ = std::move(other.stamps_);
+            producer_.store(other.producer_.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+            other.producer_.store(0, std::memory_order_relaxed);
+            consumer_.store(other.consumer_.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+            other.consumer_.store(0, std::memory_order_relaxed);
+            return *this;
+        }
+
+
+        void reserve(size_type capacity) {
+            capacity = nearest_power_of_2(capacity);
+            stamps_ = std::make_unique<std::atomic<size_type>[]>(capacity);
+            for(size_type n = 0; n != capacity; ++n)
+                stamps_[n] = n;
+            capacity_ = capacity;
+            index_mask_ = capacity - 1;
+            pool_ = std::make_unique<T[]>(capacity);
+            producer_.store(0, std::memory_order_relaxed);
+            consumer_.store(0, std::memory_order_relaxed);
+        }
+
+
+        size_type blocks_count() const noexcept {
+            return blocks_count_.load(std::memory_order_relaxed);
+        }
+
+
+        void clear_blocks_count() noexcept {
+            blocks_count_.store(0, std::memory_order_relaxed);
+        }
+
+
+        // Total time producers spent waiting for room
+        std::chrono::nanoseconds blocked_time() const noexcept {
+            return std::chrono::nanoseconds {
+                blocked_time_.load(std::memory_order_relaxed)};
+        }
+
+
+        void clear_blocked_time() noexcept {
+            blocked_time_.store(0, std::memory_order_relaxed);
+        }
+
+
+        size_type size() const noexcept {
+            return producer_.load(std::memory_order_relaxed)
+                   - consumer_.load(std::memory_order_relaxed);
+        }
+
+
+        T& operator[](sequence n) noexcept {
+            return pool_[n.value() & index_mask_];
+        }
+
+
+        T const& operator[](sequence n) const noexcept {
+            return pool_[n.value() & index_mask_];
+        }
+
+
+        // Waits for room in the queue with the given strategy,
+        // consumers release slots out of order, so producers only poll
+        template<typename W = yielding_wait>
+        sequence claim(W const& wait = W {}) noexcept {
+            if(!pool_)
+                return sequence{};
+
+            sequence const p {
+                producer_.fetch_add(1, std::memory_order_relaxed)};
+            if(vacant(p.value()))
+                return p;
+
+            wait_for_room(wait, [this, p] { return vacant(p.value()); });
+
+            return p;
+        }
+
+
+        // Takes the sequence only once its slot is free, so a timed out
+        // claim leaves no gap that would stall consumers
+        template<typename Rep, typename Period, typename W = yielding_wait>
+        sequence claim_for(std::chrono::duration<Rep, Period> const& duration,
+                           W const& wait = W {}) noexcept {
+            if(!pool_)
+                return sequence{};
+
+            auto const started = std::chrono::steady_clock::now();
+            auto const timed_out = [started, &duration] {
+                return std::chrono::steady_clock::now() - started >= duration;
+            };
+            bool blocked = false;
+            auto p = producer_.load(std::memory_order_relaxed);
+            for(;;) {
+                if(vacant(p)) {
+                    if(producer_.compare_exchange_weak(
+                           p,
+                           p + 1,
+                           std::memory_order_relaxed))
+                        return sequence {p};
+                    continue;
+                }
+
+                if(timed_out())
+                    return sequence{};
+
+                if(!blocked) {
+                    blocks_count_.fetch_add(1, std::memory_order_relaxed);
+                    blocked = true;
+                }
+
+                wait.wait_until([this, &p, &timed_out] {
+                    p = producer_.load(std::memory_order_relaxed);
+                    return vacant(p) || timed_out();
+                });
+            }
+        }
+
+
+        // Claims count contiguous sequences at once,
+        // count should not exceed capacity
+        template<typename W = yielding_wait>
+        sequence_range claim_n(size_type count, W const& wait = W {}) noexcept {
+            if(!pool_ || count <= 0 || count > capacity_)
+                return sequence_range{};
+
+            sequence const first {
+                producer_.fetch_add(count, std::memory_order_relaxed)};
+            sequence const last {first.value() + count};
+            auto const all_free = [this, first, last] {
+                for(auto n = first.value(); n != last.value(); ++n)
+                    if(!vacant(n))
+                        return false;
+                return true;
+            };
+
+            if(all_free())
+                return sequence_range{first, last};
+
+            wait_for_room(wait, all_free);
+
+            return sequence_range{first, last};
+        }
+
+
+        void publish(sequence n) noexcept {
+            stamps_[n.value() & index_mask_].store(n.value() + 1,
+                                                   std::memory_order_release);
+        }
+
+
+        // Publishes sequences [first, last)
+        void publish_range(sequence first, sequence last) noexcept {
+            for(auto n = first.value(); n != last.value(); ++n)
+                stamps_[n & index_mask_].store(n + 1,
+                                               std::memory_order_release);
+        }
+
+
+        void publish_range(sequence_range const& range) noexcept {
+            publish_range(range.first(), range.last());
+        }
+
+
+        // Whether the message at consumer cursor is published,
+        // doesn't take the message
+        bool ready() const noexcept {
+            if(!pool_)
+                return false;
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            return stamps_[c & index_mask_].load(std::memory_order_acquire)
+                   == c + 1;
+        }
+
+
+        // Takes the next published message, it's owned by the caller
+        // until fetched(n)
+        sequence try_fetch() noexcept {
+            if(!pool_)
+                return sequence{};
+
+            auto c = consumer_.load(std::memory_order_relaxed);
+            for(;;) {
+                auto const stamp =
+                    stamps_[c & index_mask_].load(std::memory_order_acquire);
+                if(stamp == c + 1) {
+                    if(consumer_.compare_exchange_weak(
+                           c,
+                           c + 1,
+                           std::memory_order_relaxed))
+                        return sequence{c};
+                } else if(stamp < c + 1) {
+                    return sequence{};
+                } else {
+                    c = consumer_.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+
+        void fetched(sequence n) noexcept {
+            stamps_[n.value() & index_mask_].store(n.value() + capacity_,
+                                                   std::memory_order_release);
+        }
+
+
+        // Takes up to max published messages at once,
+        // they are owned by the caller until fetched(first, count)
+        ring_span<T> fetch_available(size_type max) noexcept {
+            if(!pool_ || max <= 0)
+                return ring_span<T>{};
+
+            max = (std::min)(max, capacity_);
+            auto c = consumer_.load(std::memory_order_relaxed);
+            for(;;) {
+                size_type count = 0;
+                while(count != max
+                      && stamps_[(c + count) & index_mask_].load(
+                             std::memory_order_acquire)
+                             == c + count + 1)
+                    ++count;
+
+                if(count == 0) {
+                    if(stamps_[c & index_mask_].load(std::memory_order_acquire)
+                       < c + 1)
+                        return ring_span<T>{};
+                    c = consumer_.load(std::memory_order_relaxed);
+                    continue;
+                }
+
+                if(!consumer_.compare_exchange_weak(c,
+                                                    c + count,
+                                                    std::memory_order_relaxed))
+                    continue;
+
+                auto const index = c & index_mask_;
+                auto const head = (std::min)(count, capacity_ - index);
+                return ring_span<T>{
+                    std::span<T>{&pool_[index], std::size_t(head)},
+                    std::span<T>{&pool_[0], std::size_t(count - head)},
+                    sequence{c}};
+            }
+        }
+
+
+        // Releases count messages fetched at once from first
+        void fetched(sequence first, size_type count) noexcept {
+            for(auto n = first.value(); n != first.value() + count; ++n)
+                stamps_[n & index_mask_].store(n + capacity_,
+                                               std::memory_order_release);
+        }
+
+
+    private:
+        bool vacant(sequence_value p) const noexcept {
+            return stamps_[p & index_mask_].load(std::memory_order_acquire)
+                   == p;
+        }
+
+
+        template<typename W, typename F>
+        void wait_for_room(W const& wait, F&& ready) noexcept {
+            blocks_count_.fetch_add(1, std::memory_order_relaxed);
+            auto const started = std::chrono::steady_clock::now();
+
+            wait.wait_until(ready);
+
+            auto const blocked = std::chrono::steady_clock::now() - started;
+            blocked_time_.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(blocked)
+                    .count(),
+                std::memory_order_relaxed);
+        }
+
+
+        static uint64_t nearest_power_of_2(uint64_t n) {
+            if(n < 2)
+                return 2;
+            n--;
+            n |= n >> 1;
+            n |= n >> 2;
+            n |= n >> 4;
+            n |= n >> 8;
+            n |= n >> 16;
+            n |= n >> 32;
+            n++;
+            return n;
+        }
+
+    };   // mpmc_queue
+
+
+}   // namespace hydra
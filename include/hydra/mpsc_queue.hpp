@@ -5,79 +5,222 @@
 #pragma once
 
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <thread>
+#include <type_traits>
+#include <utility>
 
+#include <hydra/cacheline.hpp>
+#include <hydra/futex_event.hpp>
+#include <hydra/ring_memory.hpp>
+#include <hydra/ring_span.hpp>
 #include <hydra/sequence.hpp>
+#include <hydra/slot_storage.hpp>
+#include <hydra/wait_strategy.hpp>
 
 
 namespace hydra {
 
 
-    template<typename T>
+    // Alignment sets the isolation of producer-owned, consumer-owned and
+    // read-only fields: cacheline_size, cacheline_pair_size or packed_layout;
+    // Storage keeps messages and their stamps, see slot_storage.hpp
+    template<typename T,
+             std::size_t Alignment = cacheline_size,
+             typename Storage = separate_slots<T>>
     class mpsc_queue {
     public:
         using size_type = sequence::value_type;
         using value_type = T;
 
+        static_assert(is_valid_layout(Alignment));
+
     private:
         using sequence_value = sequence::value_type;
 
-        size_type capacity_ {0};
+        // Set in producer cursor while the consumer resizes the queue
+        static constexpr sequence_value closed_bit = sequence_value(1) << 62;
+
+        // Read-only after reserve, changed by resize while producers wait
+        alignas(Alignment) std::atomic<size_type> capacity_ {0};
         sequence_value index_mask_ {0};
-        std::unique_ptr<T[]> pool_;
-        std::unique_ptr<std::atomic<sequence_value>[]> published_;
-        std::atomic<sequence_value> producer_ {0};
-        sequence_value consumer_ {0};
+        Storage slots_;
+        size_type release_threshold_ {0};
+        // Producer-owned
+        alignas(Alignment) std::atomic<sequence_value> producer_ {0};
+        std::atomic<sequence_value> consumer_cache_ {0};
         std::atomic<size_type> blocks_count_ {0};
+        std::atomic<std::int64_t> blocked_time_ {0};
+        // Consumer-owned
+        alignas(Alignment) std::atomic<sequence_value> consumer_ {0};
+        sequence_value published_until_ {0};
+        sequence_value released_at_ {0};
+        std::atomic<sequence_value> closed_at_ {-1};
+        std::atomic<size_type> resizes_count_ {0};
+        std::atomic<std::int64_t> resize_time_ {0};
+        // Parked producers
+        alignas(Alignment) futex_event released_;
 
     public:
         mpsc_queue() noexcept = default;
         mpsc_queue(mpsc_queue const&) = delete;
         mpsc_queue& operator=(mpsc_queue const&) = delete;
         mpsc_queue(size_type capacity) { reserve(capacity); }
-        explicit operator bool() noexcept { return !!pool_; }
-        size_type capacity() const noexcept { return capacity_; }
+        explicit operator bool() noexcept { return !!slots_; }
+        size_type capacity() const noexcept {
+            return capacity_.load(std::memory_order_relaxed);
+        }
+        size_type resizes_count() const noexcept {
+            return resizes_count_.load(std::memory_order_relaxed);
+        }
+        // Total time producers were held by resizes
+        std::chrono::nanoseconds resize_time() const noexcept {
+            return std::chrono::nanoseconds {
+                resize_time_.load(std::memory_order_relaxed)};
+        }
 
 
         mpsc_queue(mpsc_queue&& other) noexcept
-            : capacity_ {other.capacity_},
+            : capacity_ {other.capacity_.load(std::memory_order_relaxed)},
               index_mask_ {other.index_mask_},
-              pool_ {std::move(other.pool_)},
-              published_ {std::move(other.published_)},
+              slots_ {std::move(other.slots_)},
+              release_threshold_ {other.release_threshold_},
               producer_ {other.producer_.load(std::memory_order_relaxed)},
-              consumer_ {other.consumer_} {
-            other.capacity_ = 0;
+              consumer_cache_ {
+                  other.consumer_cache_.load(std::memory_order_relaxed)},
+              consumer_ {other.consumer_.load(std::memory_order_relaxed)},
+              published_until_ {other.published_until_},
+              released_at_ {other.released_at_} {
+            other.capacity_.store(0, std::memory_order_relaxed);
             other.producer_.store(0, std::memory_order_relaxed);
-            other.consumer_ = 0;
+            other.consumer_cache_.store(0, std::memory_order_relaxed);
+            other.consumer_.store(0, std::memory_order_relaxed);
+            other.published_until_ = 0;
+            other.released_at_ = 0;
+        }
+
+
+        // Destroys messages published and not fetched
+        ~mpsc_queue() {
+            if constexpr(Storage::lifetime == slot_lifetime::per_message) {
+                if(!slots_)
+                    return;
+                auto const c = consumer_.load(std::memory_order_relaxed);
+                for(auto n = c; n - c < capacity(); ++n)
+                    if(slots_.stamp(n & index_mask_).load(
+                           std::memory_order_acquire)
+                       == n + 1)
+                        slots_.destroy(n & index_mask_);
+            }
         }
 
 
         mpsc_queue& operator=(mpsc_queue&& other) noexcept {
-            capacity_ = other.capacity_;
-            other.capacity_ = 0;
+            capacity_.store(other.capacity_.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+            other.capacity_.store(0, std::memory_order_relaxed);
             index_mask_ = other.index_mask_;
-            pool_ = std::move(other.pool_);
-            published_ = std::move(other.published_);
+            slots_ = std::move(other.slots_);
+            release_threshold_ = other.release_threshold_;
             producer_.store(other.producer_.load(std::memory_order_relaxed),
                             std::memory_order_relaxed);
             other.producer_.store(0, std::memory_order_relaxed);
-            consumer_ = other.consumer_;
-            other.consumer_ = 0;
+            consumer_cache_.store(
+                other.consumer_cache_.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+            other.consumer_cache_.store(0, std::memory_order_relaxed);
+            consumer_.store(other.consumer_.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+            other.consumer_.store(0, std::memory_order_relaxed);
+            published_until_ = other.published_until_;
+            other.published_until_ = 0;
+            released_at_ = other.released_at_;
+            other.released_at_ = 0;
             return *this;
         }
 
 
-        void reserve(size_type capacity) {
+        // Memory options place the ring on huge pages or a NUMA node
+        void reserve(size_type capacity, memory_options const& memory = {}) {
             capacity = nearest_power_of_2(capacity);
-            published_ = std::make_unique<std::atomic<size_type>[]>(capacity);
-            for(size_type n = 0; n != capacity; ++n)
-                published_[n] = 0;
-            capacity_ = capacity;
+            slots_.reserve(capacity, memory);
+            capacity_.store(capacity, std::memory_order_relaxed);
             index_mask_ = capacity - 1;
-            pool_ = std::make_unique<T[]>(capacity);
+            published_until_ = consumer_.load(std::memory_order_relaxed);
+            released_at_ = published_until_;
+        }
+
+
+        // Changes capacity of an active queue, should be called by the
+        // consumer between batches. Producers are held while published
+        // messages move to the new ring, in-flight ones are waited for.
+        // Fails when claimed messages do not fit into the new capacity
+        bool resize(size_type capacity) {
+            capacity = nearest_power_of_2(capacity);
+            auto const old_capacity = capacity_.load(std::memory_order_relaxed);
+            if(!slots_ || capacity == old_capacity)
+                return false;
+
+            Storage slots;
+            slots.reserve(capacity, slots_.memory());
+
+            auto const started = std::chrono::steady_clock::now();
+            auto const closed =
+                producer_.fetch_or(closed_bit, std::memory_order_acq_rel);
+            // Producers held by the previous resize may go on
+            closed_at_.store(closed, std::memory_order_release);
+            released_.notify_all();
+
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            bool const fit = closed - c <= capacity;
+            if(fit) {
+                // Messages beyond old capacity are not written yet
+                auto const last = (std::min)(closed, c + old_capacity);
+                auto const index_mask = capacity - 1;
+                for(auto n = c; n != last; ++n) {
+                    auto& stamp = slots_.stamp(n & index_mask_);
+                    while(stamp.load(std::memory_order_acquire) != n + 1)
+                        std::this_thread::yield();
+                    slots.construct(n & index_mask,
+                                    std::move(slots_.value(n & index_mask_)));
+                    slots_.destroy(n & index_mask_);
+                    slots.stamp(n & index_mask)
+                        .store(n + 1, std::memory_order_relaxed);
+                }
+                slots_ = std::move(slots);
+                index_mask_ = index_mask;
+                capacity_.store(capacity, std::memory_order_release);
+                published_until_ = c;
+                released_at_ = c;
+            }
+
+            producer_.fetch_and(~closed_bit, std::memory_order_release);
+            released_.notify_all();
+
+            auto const paused = std::chrono::steady_clock::now() - started;
+            resize_time_.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(paused)
+                    .count(),
+                std::memory_order_relaxed);
+            if(fit)
+                resizes_count_.fetch_add(1, std::memory_order_relaxed);
+            return fit;
+        }
+
+
+        // Producers blocked by full queue park on a futex instead of
+        // polling, the consumer wakes them after releasing threshold
+        // slots or when it runs out of messages; 0 disables parking.
+        // Producers park whatever wait strategy they claim with,
+        // adaptive_wait still spins before parking
+        void park_producers(size_type release_threshold) noexcept {
+            release_threshold_ = release_threshold;
         }
 
 
@@ -91,85 +234,413 @@ namespace hydra {
         }
 
 
+        // Total time producers spent waiting for room
+        std::chrono::nanoseconds blocked_time() const noexcept {
+            return std::chrono::nanoseconds {
+                blocked_time_.load(std::memory_order_relaxed)};
+        }
+
+
+        void clear_blocked_time() noexcept {
+            blocked_time_.store(0, std::memory_order_relaxed);
+        }
+
+
+        // Producers parked or about to park waiting for room
+        std::uint32_t parked_producers() const noexcept {
+            return released_.waiters();
+        }
+
+
         size_type size() const noexcept {
-            return producer_.load(std::memory_order_relaxed) - consumer_;
+            return (producer_.load(std::memory_order_relaxed) & ~closed_bit)
+                   - consumer_.load(std::memory_order_relaxed);
         }
 
 
         T& operator[](sequence n) noexcept {
-            return pool_[n.value() & index_mask_];
+            return slots_.value(n.value() & index_mask_);
         }
 
 
         T const& operator[](sequence n) const noexcept {
-            return pool_[n.value() & index_mask_];
+            return slots_.value(n.value() & index_mask_);
+        }
+
+
+        // Constructs message in the claimed slot, the only way to fill
+        // slots of storage with per_message lifetime
+        template<typename... Args>
+        void construct(sequence n, Args&&... args) {
+            slots_.construct(n.value() & index_mask_,
+                             std::forward<Args>(args)...);
+        }
+
+
+        // Claims, constructs and publishes a message
+        template<typename... Args>
+        sequence emplace(Args&&... args) {
+            auto const n = claim();
+            if(!n)
+                return n;
+            construct(n, std::forward<Args>(args)...);
+            publish(n);
+            return n;
         }
 
 
-        sequence claim() noexcept {
-            if(!pool_)
+        // Waits for room in the queue with the given strategy
+        template<typename W = yielding_wait>
+        sequence claim(W const& wait = W {}) noexcept {
+            if(capacity_.load(std::memory_order_relaxed) == 0)
                 return sequence{};
 
-            sequence const p{
-                producer_.fetch_add(1, std::memory_order_relaxed)};
-            if(p.value() - consumer_ < capacity_)
+            sequence const p {claim_cursor(wait)};
+            if(fits(p.value()))
                 return p;
 
-            blocks_count_.fetch_add(1, std::memory_order_relaxed);
-
-            while(p.value() - consumer_ >= capacity_)
-                std::this_thread::yield();
+            wait_for_room(wait, [this, p] { return fits(p.value()); });
 
             return p;
         }
 
 
-        template<typename Rep, typename Period>
-        sequence claim_for(
-            std::chrono::duration<Rep, Period> const& duration) noexcept {
-
-            if(!pool_)
+        // Claims a sequence only once it fits, so a claim that times out
+        // leaves nothing for the consumer or resize to wait for
+        template<typename Rep, typename Period, typename W = yielding_wait>
+        sequence claim_for(std::chrono::duration<Rep, Period> const& duration,
+                           W const& wait = W {}) noexcept {
+            if(capacity_.load(std::memory_order_relaxed) == 0)
                 return sequence{};
 
-            sequence const p{
-                producer_.fetch_add(1, std::memory_order_relaxed)};
+            auto const started = std::chrono::steady_clock::now();
+            auto const timed_out = [started, &duration] {
+                return std::chrono::steady_clock::now() - started >= duration;
+            };
+            bool blocked = false;
+            auto p = producer_.load(std::memory_order_acquire);
+            for(;;) {
+                if((p & closed_bit) != 0) {
+                    wait_for_resize(wait, p & ~closed_bit);
+                } else if(fits(p)) {
+                    if(producer_.compare_exchange_weak(
+                           p,
+                           p + 1,
+                           std::memory_order_acquire,
+                           std::memory_order_acquire))
+                        return sequence{p};
+                    continue;
+                } else {
+                    if(timed_out())
+                        return sequence{};
+                    if(!blocked) {
+                        blocks_count_.fetch_add(1, std::memory_order_relaxed);
+                        blocked = true;
+                    }
+                    wait.wait_until([this, p, &timed_out] {
+                        return fits(p)
+                               || producer_.load(std::memory_order_relaxed)
+                                      != p
+                               || timed_out();
+                    });
+                }
+                p = producer_.load(std::memory_order_acquire);
+            }
+        }
 
-            if(p.value() - consumer_ < capacity_)
-                return p;
 
-            blocks_count_.fetch_add(1, std::memory_order_relaxed);
+        // Claims count contiguous sequences at once, count should not
+        // exceed capacity. Sequences are claimed only when all of them
+        // fit, so resize never waits for a range held by a blocked producer
+        template<typename W = yielding_wait>
+        sequence_range claim_n(size_type count, W const& wait = W {}) noexcept {
+            auto p = producer_.load(std::memory_order_acquire);
+            for(;;) {
+                if(count <= 0
+                   || count > capacity_.load(std::memory_order_relaxed))
+                    return sequence_range{};
+
+                if((p & closed_bit) != 0) {
+                    wait_for_resize(wait, p & ~closed_bit);
+                } else if(fits(p + count - 1)) {
+                    if(producer_.compare_exchange_weak(
+                           p,
+                           p + count,
+                           std::memory_order_acquire,
+                           std::memory_order_acquire))
+                        return sequence_range{sequence{p}, sequence{p + count}};
+                    continue;
+                } else {
+                    wait_for_room(wait, [this, p, count] {
+                        return fits(p + count - 1)
+                               || producer_.load(std::memory_order_relaxed)
+                                      != p;
+                    });
+                }
+                p = producer_.load(std::memory_order_acquire);
+            }
+        }
 
-            auto const started = std::chrono::steady_clock::now();
 
-            while(p.value() - consumer_ >= capacity_) {
-                std::this_thread::yield();
+        void publish(sequence n) noexcept {
+            slots_.stamp(n.value() & index_mask_).store(
+                n.value() + 1,
+                std::memory_order_release);
+        }
 
-                if(std::chrono::steady_clock::now() - started >= duration)
-                    return sequence{};
-            }
 
-            return p;
+        // Publishes sequences [first, last)
+        void publish_range(sequence first, sequence last) noexcept {
+            for(auto n = first.value(); n != last.value(); ++n)
+                slots_.stamp(n & index_mask_).store(n + 1,
+                                                    std::memory_order_release);
         }
 
 
-        void publish(sequence n) noexcept {
-            published_[n.value() & index_mask_] = n.value() + 1;
+        void publish_range(sequence_range const& range) noexcept {
+            publish_range(range.first(), range.last());
         }
 
 
         sequence try_fetch() noexcept {
-            if(!pool_)
+            if(!slots_)
                 return sequence{};
-            if(published_[consumer_ & index_mask_] != consumer_ + 1)
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            if(!published(c)) {
+                release_on_idle(c);
                 return sequence{};
-            return sequence{consumer_};
+            }
+            return sequence{c};
+        }
+
+
+        // Whether the message at consumer cursor is published
+        bool ready() noexcept { return !!try_fetch(); }
+
+
+        void fetched() noexcept {
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            slots_.destroy(c & index_mask_);
+            consumer_.store(c + 1, std::memory_order_release);
+            release(c + 1);
+        }
+
+
+        // Returns up to max published messages following consumer cursor
+        ring_span<T> fetch_available(size_type max) noexcept
+            requires Storage::contiguous
+        {
+            if(!slots_ || max <= 0)
+                return ring_span<T>{};
+
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            auto n = c;
+            while(n - c < max && published(n))
+                n = (std::min)(published_until_, c + max);
+            if(n == c)
+                release_on_idle(c);
+
+            auto const index = c & index_mask_;
+            auto const count = n - c;
+            auto const head = (std::min)(
+                count,
+                capacity_.load(std::memory_order_relaxed) - index);
+            return ring_span<T>{
+                std::span<T>{slots_.values() + index, std::size_t(head)},
+                std::span<T>{slots_.values(), std::size_t(count - head)},
+                sequence{c}};
         }
 
 
-        void fetched() noexcept { ++consumer_; }
+        // Releases count messages fetched at once
+        void fetched(size_type count) noexcept {
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            for(auto n = c; n != c + count; ++n)
+                slots_.destroy(n & index_mask_);
+            consumer_.store(c + count, std::memory_order_release);
+            release(c + count);
+        }
+
+
+        // Copies count messages into the queue with at most two memcpy
+        // per claimed range (slot by slot for interleaved storage),
+        // waits for room when count exceeds capacity
+        template<typename W = yielding_wait>
+        bool push_bulk(T const* in, size_type count, W const& wait = W {})
+            requires std::is_trivially_copyable_v<T>
+        {
+            while(count > 0) {
+                auto const range = claim_n((std::min)(count, capacity()), wait);
+                if(!range)
+                    return false;
+                auto const claimed = range.size();
+                auto const index = range.first().value() & index_mask_;
+                if constexpr(Storage::contiguous) {
+                    auto const head = (std::min)(claimed, capacity() - index);
+                    std::memcpy(slots_.values() + index,
+                                in,
+                                std::size_t(head) * sizeof(T));
+                    std::memcpy(slots_.values(),
+                                in + head,
+                                std::size_t(claimed - head) * sizeof(T));
+                } else {
+                    for(size_type i = 0; i != claimed; ++i)
+                        slots_.value((index + i) & index_mask_) = in[i];
+                }
+                publish_range(range);
+                in += claimed;
+                count -= claimed;
+            }
+            return true;
+        }
+
+
+        // Copies up to max published messages out of the queue
+        // with at most two memcpy (slot by slot for interleaved storage)
+        // and a single cursor update
+        size_type try_pop_bulk(T* out, size_type max) noexcept
+            requires std::is_trivially_copyable_v<T>
+        {
+            if constexpr(Storage::contiguous) {
+                auto const messages = fetch_available(max);
+                auto const count = size_type(messages.size());
+                if(count == 0)
+                    return 0;
+                std::memcpy(out,
+                            messages.head.data(),
+                            messages.head.size() * sizeof(T));
+                std::memcpy(out + messages.head.size(),
+                            messages.tail.data(),
+                            messages.tail.size() * sizeof(T));
+                fetched(count);
+                return count;
+            } else {
+                if(!slots_ || max <= 0)
+                    return 0;
+                auto const c = consumer_.load(std::memory_order_relaxed);
+                size_type count = 0;
+                for(; count != max && published(c + count); ++count)
+                    out[count] = slots_.value((c + count) & index_mask_);
+                if(count == 0) {
+                    release_on_idle(c);
+                    return 0;
+                }
+                fetched(count);
+                return count;
+            }
+        }
 
 
     private:
+        // Producers claiming while the queue is resized
+        // go on once the resize is over
+        template<typename W>
+        sequence_value claim_cursor(W const& wait) noexcept {
+            auto const p = producer_.fetch_add(1, std::memory_order_acquire);
+            if((p & closed_bit) == 0)
+                return p;
+            wait_for_resize(wait, p & ~closed_bit);
+            return p & ~closed_bit;
+        }
+
+
+        // Polling strategies would ignore released_ and never park
+        template<typename W, typename F>
+        void park(W const& wait, F&& ready) noexcept {
+            if constexpr(std::is_same_v<W, adaptive_wait>)
+                wait.wait_until(released_, ready);
+            else
+                blocking_wait {}.wait_until(released_, ready);
+        }
+
+
+        // Resize is over when the cursor is open or when the next resize
+        // has closed it beyond p
+        template<typename W>
+        void wait_for_resize(W const& wait, sequence_value p) noexcept {
+            auto const resized = [this, p] {
+                return (producer_.load(std::memory_order_acquire) & closed_bit)
+                           == 0
+                       || closed_at_.load(std::memory_order_acquire) > p;
+            };
+            if(release_threshold_ == 0)
+                wait.wait_until(resized);
+            else
+                park(wait, resized);
+        }
+
+
+        template<typename W, typename F>
+        void wait_for_room(W const& wait, F&& ready) noexcept {
+            blocks_count_.fetch_add(1, std::memory_order_relaxed);
+            auto const started = std::chrono::steady_clock::now();
+
+            if(release_threshold_ == 0)
+                wait.wait_until(ready);
+            else
+                park(wait, ready);
+
+            auto const blocked = std::chrono::steady_clock::now() - started;
+            blocked_time_.fetch_add(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(blocked)
+                    .count(),
+                std::memory_order_relaxed);
+        }
+
+
+        // Wakes parked producers once per threshold released slots
+        void release(sequence_value c) noexcept {
+            if(release_threshold_ == 0 || c - released_at_ < release_threshold_)
+                return;
+            released_at_ = c;
+            released_.notify_all();
+        }
+
+
+        // Wakes parked producers when there is nothing more to consume
+        // but some slots were released since the last wakeup
+        void release_on_idle(sequence_value c) noexcept {
+            if(release_threshold_ == 0 || c == released_at_)
+                return;
+            released_at_ = c;
+            released_.notify_all();
+        }
+
+
+        // Rereads consumer cursor only when the cached one says
+        // there is no room for p, the cache is shared by producers
+        bool fits(sequence_value p) noexcept {
+            auto const cached = consumer_cache_.load(std::memory_order_acquire);
+            if(p - cached < capacity_.load(std::memory_order_acquire))
+                return true;
+            auto const c = consumer_.load(std::memory_order_acquire);
+            consumer_cache_.store(c, std::memory_order_release);
+            return p - c < capacity_.load(std::memory_order_acquire);
+        }
+
+
+        // Rescans stamps only when the cached high-water mark is reached,
+        // the scan stops at the first unpublished message or at the end
+        // of stamps cache line
+        bool published(sequence_value c) noexcept {
+            if(c < published_until_)
+                return true;
+
+            constexpr auto stamps_per_line =
+                sequence_value(Storage::stamps_per_line);
+            auto n = c;
+            do {
+                if(slots_.stamp(n & index_mask_).load(std::memory_order_acquire)
+                   != n + 1)
+                    break;
+                ++n;
+            } while((n & (stamps_per_line - 1)) != 0);
+
+            published_until_ = n;
+            return n != c;
+        }
+
+
         static uint64_t nearest_power_of_2(uint64_t n) {
             if(n < 2)
                 return 2;
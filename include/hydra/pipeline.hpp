@@ -0,0 +1,189 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <hydra/batch.hpp>
+#include <hydra/broadcast_queue.hpp>
+#include <hydra/futex_event.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    // Runs a worker per stage over a single broadcast_queue,
+    // a stage sees a message only after its upstream stages processed it
+    template<typename M, typename W = blocking_wait>
+    class pipeline {
+    public:
+        using message_type = M;
+        using queue_type = broadcast_queue<M>;
+        using consumer_type = typename queue_type::consumer;
+        using wait_strategy = W;
+        using size_type = typename queue_type::size_type;
+        using batch_type = batch<consumer_type>;
+        using handler_type = std::function<void(batch_type&)>;
+        using stage_id = std::size_t;
+
+    private:
+        struct stage {
+            consumer_type& messages;
+            handler_type handler;
+            std::vector<stage_id> downstreams {};
+            std::thread worker {};
+            futex_event new_message {};
+            std::atomic<std::uint64_t> messages_processed {0};
+            std::atomic_flag stopping {};
+        };   // stage
+
+        queue_type messages_;
+        std::vector<std::unique_ptr<stage>> stages_;
+        std::vector<stage_id> roots_;
+        wait_strategy wait_;
+
+    public:
+        pipeline() noexcept = default;
+        explicit pipeline(wait_strategy wait) noexcept: wait_ {wait} {}
+        pipeline(pipeline const&) noexcept = delete;
+        pipeline& operator=(pipeline const&) noexcept = delete;
+        ~pipeline() { stop(); }
+        bool active() const noexcept {
+            return !stages_.empty() && stages_.front()->worker.joinable();
+        }
+        std::size_t stages_count() const noexcept { return stages_.size(); }
+        std::uint64_t messages_processed(stage_id id) const noexcept {
+            return stages_[id]->messages_processed.load(
+                std::memory_order_relaxed);
+        }
+        sequence claim() noexcept { return messages_.claim(wait_); }
+        sequence_range claim_n(size_type count) noexcept {
+            return messages_.claim_n(count, wait_);
+        }
+        message_type& operator[](sequence n) noexcept { return messages_[n]; }
+        void reserve(size_type n) { messages_.reserve(n); }
+        size_type blocks_count() const noexcept {
+            return messages_.blocks_count();
+        }
+        std::chrono::nanoseconds blocked_time() const noexcept {
+            return messages_.blocked_time();
+        }
+
+        template<typename Rep, typename Period>
+        sequence claim_for(
+            std::chrono::duration<Rep, Period> const& duration) noexcept {
+            return messages_.claim_for(duration, wait_);
+        }
+
+
+        // Adds a stage following upstream stages, stages should be
+        // added before run, upstreams are added before their downstreams
+        stage_id add_stage(handler_type handler,
+                           std::vector<stage_id> const& upstreams = {}) {
+            auto const id = stages_.size();
+            std::vector<consumer_type const*> cursors;
+            for(auto const upstream: upstreams) {
+                cursors.push_back(&stages_[upstream]->messages);
+                stages_[upstream]->downstreams.push_back(id);
+            }
+            if(upstreams.empty())
+                roots_.push_back(id);
+
+            auto& messages = messages_.subscribe(std::move(cursors));
+            stages_.push_back(std::unique_ptr<stage>(
+                new stage {messages, std::move(handler)}));
+            return id;
+        }
+
+
+        void publish(sequence n) noexcept {
+            messages_.publish(n);
+            notify(roots_);
+        }
+
+
+        // Publishes sequences [first, last) with a single wakeup per stage
+        void publish_range(sequence first, sequence last) noexcept {
+            messages_.publish_range(first, last);
+            notify(roots_);
+        }
+
+
+        void publish_range(sequence_range const& range) noexcept {
+            publish_range(range.first(), range.last());
+        }
+
+
+        // Stops stages in order they were added, so every stage
+        // drains messages left by its upstreams
+        void stop() noexcept {
+            if(!active())
+                return;
+            for(auto& each: stages_) {
+                each->stopping.test_and_set(std::memory_order_release);
+                each->new_message.notify_one();
+                each->worker.join();
+                each->stopping.clear(std::memory_order_relaxed);
+            }
+        }
+
+
+        bool run() {
+            if(active() || stages_.empty() || !messages_)
+                return false;
+
+            for(auto& each: stages_)
+                each->worker =
+                    std::thread {[this, &current = *each] { work(current); }};
+
+            return true;
+        }
+
+
+    private:
+        void notify(std::vector<stage_id> const& ids) noexcept {
+            for(auto const id: ids)
+                stages_[id]->new_message.notify_one();
+        }
+
+
+        void work(stage& current) {
+            for(;;) {
+                wait_.wait_until(current.new_message, [&current] {
+                    return current.messages.ready()
+                           || current.stopping.test(std::memory_order_acquire);
+                });
+
+                bool const stopping =
+                    current.stopping.test(std::memory_order_acquire);
+
+                if(current.messages.ready()) {
+                    auto messages = batch_type {current.messages};
+                    current.handler(messages);
+                    current.messages_processed.fetch_add(
+                        messages.fetched_count(),
+                        std::memory_order_relaxed);
+                    if(messages.fetched_count() != 0)
+                        notify(current.downstreams);
+                    if(!stopping || messages.fetched_count() != 0)
+                        continue;
+                }
+
+                if(stopping)
+                    break;
+            }
+        }
+    };   // pipeline
+
+
+}   // namespace hydra
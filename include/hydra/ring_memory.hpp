@@ -0,0 +1,183 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <utility>
+
+#if defined(__linux__)
+
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+
+#endif
+
+#include <hydra/cacheline.hpp>
+
+
+namespace hydra {
+
+
+    enum class page_size : std::uint8_t {
+        regular,
+        // Fall back to transparent huge pages when hugetlbfs pool is empty
+        huge_2mb,
+        huge_1gb
+    };   // page_size
+
+
+    struct memory_options {
+        // Node to bind memory to, -1 leaves placement to the kernel
+        int numa_node {-1};
+        page_size pages {page_size::regular};
+        // Touches every page at reserve, so no page faults later
+        bool prefault {false};
+    };   // memory_options
+
+
+    // Raw block of memory placed as memory options say; regular pages
+    // without a node come from the heap, anything else is mapped
+    class ring_memory {
+    public:
+        static constexpr std::size_t alignment = cacheline_pair_size;
+
+        ring_memory() noexcept = default;
+        ring_memory(ring_memory const&) = delete;
+        ring_memory& operator=(ring_memory const&) = delete;
+        ~ring_memory() { release(); }
+
+
+        ring_memory(std::size_t bytes, memory_options const& options) {
+            bytes = (std::max)(bytes, std::size_t(1));
+            auto mapped = bytes;
+            void* p = map(mapped, options);
+            if(p != nullptr)
+                mapped_ = mapped;
+            else
+                p = ::operator new(bytes, std::align_val_t {alignment});
+            data_ = static_cast<std::byte*>(p);
+            // Rounding of the mapping is left untouched
+            if(options.prefault)
+                std::memset(p, 0, bytes);
+        }
+
+
+        ring_memory(ring_memory&& other) noexcept
+            : data_ {std::exchange(other.data_, nullptr)}
+            , mapped_ {std::exchange(other.mapped_, 0)} {}
+
+
+        ring_memory& operator=(ring_memory&& other) noexcept {
+            if(this == &other)
+                return *this;
+            release();
+            data_ = std::exchange(other.data_, nullptr);
+            mapped_ = std::exchange(other.mapped_, 0);
+            return *this;
+        }
+
+
+        explicit operator bool() const noexcept { return data_ != nullptr; }
+        std::byte* data() const noexcept { return data_; }
+        // Bytes mapped by mmap, zero for heap memory
+        std::size_t mapped() const noexcept { return mapped_; }
+
+    private:
+        std::byte* data_ {nullptr};
+        std::size_t mapped_ {0};
+
+
+        void release() noexcept {
+            if(data_ == nullptr)
+                return;
+#if defined(__linux__)
+            if(mapped_ != 0) {
+                munmap(data_, mapped_);
+                data_ = nullptr;
+                return;
+            }
+#endif
+            ::operator delete(data_, std::align_val_t {alignment});
+            data_ = nullptr;
+        }
+
+
+        // Returns nullptr when heap memory will do, rounds bytes
+        // up to the size of pages actually mapped otherwise
+        static void* map(std::size_t& bytes, memory_options const& options) {
+#if defined(__linux__)
+            if(options.pages == page_size::regular && options.numa_node < 0)
+                return nullptr;
+
+            auto const round_up = [](std::size_t n, std::size_t page) {
+                return (n + page - 1) / page * page;
+            };
+            auto const regular_page = std::size_t(sysconf(_SC_PAGESIZE));
+            std::size_t page = regular_page;
+            int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+            if(options.pages == page_size::huge_2mb) {
+                page = std::size_t(1) << 21;
+                flags |= MAP_HUGETLB | (21 << MAP_HUGE_SHIFT);
+            } else if(options.pages == page_size::huge_1gb) {
+                page = std::size_t(1) << 30;
+                flags |= MAP_HUGETLB | (30 << MAP_HUGE_SHIFT);
+            }
+            auto mapped = round_up(bytes, page);
+
+            void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, flags,
+                           -1, 0);
+            if(p == MAP_FAILED && (flags & MAP_HUGETLB) != 0) {
+                // Regular pages need no huge page rounding
+                mapped = round_up(bytes, regular_page);
+                p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if(p != MAP_FAILED)
+                    madvise(p, mapped, MADV_HUGEPAGE);
+            }
+            if(p == MAP_FAILED)
+                throw std::bad_alloc {};
+
+            bytes = mapped;
+            if(options.numa_node >= 0)
+                bind(p, bytes, options.numa_node);
+            return p;
+#else
+            (void)bytes;
+            (void)options;
+            return nullptr;
+#endif
+        }
+
+
+        // Best effort: placement is left to the kernel when the node
+        // is unknown or NUMA policy is not supported
+        static void bind(void* p, std::size_t bytes, int node) noexcept {
+#if defined(__linux__) && defined(SYS_mbind)
+            constexpr long bind_policy = 2;   // MPOL_BIND
+            constexpr auto mask_bits = sizeof(unsigned long) * CHAR_BIT;
+            unsigned long mask[1024 / mask_bits] = {};
+            if(std::size_t(node) >= sizeof(mask) * CHAR_BIT)
+                return;
+            mask[std::size_t(node) / mask_bits] |= 1ul
+                << (std::size_t(node) % mask_bits);
+            syscall(SYS_mbind, p, bytes, bind_policy, mask,
+                    sizeof(mask) * CHAR_BIT + 1, 0);
+#else
+            (void)p;
+            (void)bytes;
+            (void)node;
+#endif
+        }
+    };   // ring_memory
+
+
+}   // namespace hydra
@@ -0,0 +1,38 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <cstddef>
+#include <span>
+
+#include <hydra/sequence.hpp>
+
+
+namespace hydra {
+
+
+    // Contiguous messages of a ring starting from sequence first,
+    // split in two at the end of the ring
+    template<typename T>
+    struct ring_span {
+        using size_type = std::size_t;
+        using value_type = T;
+
+        std::span<T> head;
+        std::span<T> tail;
+        sequence first;
+
+        size_type size() const noexcept { return head.size() + tail.size(); }
+        bool empty() const noexcept { return head.empty(); }
+
+        T& operator[](size_type n) const noexcept {
+            return n < head.size() ? head[n] : tail[n - head.size()];
+        }
+
+    };   // ring_span
+
+
+}   // namespace hydra
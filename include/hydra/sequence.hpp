@@ -35,4 +35,64 @@ namespace hydra {
     };   // sequence
 
 
+    // Contiguous range [first, last) of sequences, slots of the range
+    // may wrap around the end of a ring
+    struct sequence_range {
+        using value_type = sequence::value_type;
+
+        class iterator {
+        public:
+            using value_type = sequence;
+            using difference_type = sequence::value_type;
+
+            iterator() noexcept = default;
+            explicit iterator(value_type n) noexcept: n_ {n} {}
+            sequence operator*() const noexcept { return n_; }
+
+            iterator& operator++() noexcept {
+                n_ = sequence {n_.value() + 1};
+                return *this;
+            }
+
+            iterator operator++(int) noexcept {
+                auto const it = *this;
+                ++*this;
+                return it;
+            }
+
+            bool operator==(iterator const& other) const noexcept {
+                return n_ == other.n_;
+            }
+
+            bool operator!=(iterator const& other) const noexcept {
+                return n_ != other.n_;
+            }
+
+        private:
+            sequence n_;
+        };   // iterator
+
+
+        constexpr sequence_range() noexcept = default;
+        sequence_range(sequence_range const&) noexcept = default;
+        sequence_range& operator=(sequence_range const&) noexcept = default;
+        explicit operator bool() const noexcept { return !!first_; }
+        sequence first() const noexcept { return first_; }
+        sequence last() const noexcept { return last_; }
+        value_type size() const noexcept {
+            return last_.value() - first_.value();
+        }
+        iterator begin() const noexcept { return iterator {first_}; }
+        iterator end() const noexcept { return iterator {last_}; }
+
+        constexpr sequence_range(sequence first, sequence last) noexcept
+            : first_ {first}, last_ {last} {}
+
+    private:
+        sequence first_;
+        sequence last_;
+
+    };   // sequence_range
+
+
 }   // namespace hydra
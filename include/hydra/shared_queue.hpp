@@ -0,0 +1,425 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__linux__)
+
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+
+#else
+
+#    error Shared queues are supported on Linux only
+
+#endif
+
+#include <hydra/cacheline.hpp>
+#include <hydra/futex_event.hpp>
+#include <hydra/sequence.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    enum class shared_queue_kind : std::uint32_t { spsc = 1, mpsc = 2 };
+
+
+    // Beginning of a shared region, stamps and messages follow it;
+    // version is bumped whenever the layout changes
+    struct shared_queue_header {
+        static constexpr std::uint64_t magic_value = 0x5148534152445948;
+        static constexpr std::uint32_t current_version = 1;
+
+        std::uint64_t magic {0};
+        std::uint32_t version {0};
+        shared_queue_kind kind {shared_queue_kind::spsc};
+        std::uint64_t capacity {0};
+        std::uint64_t element_size {0};
+        std::uint64_t element_alignment {0};
+        std::uint64_t stamps_offset {0};
+        std::uint64_t messages_offset {0};
+        std::uint64_t region_size {0};
+        // Set last by the creator, attach fails until then
+        std::atomic<std::uint32_t> ready {0};
+
+        alignas(cacheline_size) std::atomic<sequence::value_type> producer {0};
+        alignas(cacheline_size) std::atomic<sequence::value_type> consumer {0};
+        // Consumer process parks here waiting for messages
+        alignas(cacheline_size) shared_futex_event published;
+    };   // shared_queue_header
+
+
+    // Queue in memory shared between processes: a named POSIX shared
+    // memory object or an anonymous memfd passed to another process.
+    // Handles are per process and per thread like queue roles are
+    template<typename T, shared_queue_kind Kind>
+    class shared_queue {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = T;
+
+        static_assert(std::is_trivially_copyable_v<T>);
+        static_assert(alignof(T) <= cacheline_size);
+        static_assert(std::atomic<sequence::value_type>::is_always_lock_free);
+
+    private:
+        using sequence_value = sequence::value_type;
+        using stamp_type = std::atomic<sequence_value>;
+
+        int fd_ {-1};
+        std::byte* region_ {nullptr};
+        std::size_t region_size_ {0};
+        shared_queue_header* header_ {nullptr};
+        stamp_type* stamps_ {nullptr};
+        T* messages_ {nullptr};
+        size_type capacity_ {0};
+        sequence_value index_mask_ {0};
+        // Producer side
+        sequence_value consumer_cache_ {0};
+
+    public:
+        shared_queue() noexcept = default;
+        shared_queue(shared_queue const&) = delete;
+        shared_queue& operator=(shared_queue const&) = delete;
+        ~shared_queue() { close(); }
+
+
+        shared_queue(shared_queue&& other) noexcept
+            : fd_ {std::exchange(other.fd_, -1)}
+            , region_ {std::exchange(other.region_, nullptr)}
+            , region_size_ {std::exchange(other.region_size_, 0)}
+            , header_ {std::exchange(other.header_, nullptr)}
+            , stamps_ {std::exchange(other.stamps_, nullptr)}
+            , messages_ {std::exchange(other.messages_, nullptr)}
+            , capacity_ {std::exchange(other.capacity_, 0)}
+            , index_mask_ {std::exchange(other.index_mask_, 0)}
+            , consumer_cache_ {std::exchange(other.consumer_cache_, 0)} {}
+
+
+        shared_queue& operator=(shared_queue&& other) noexcept {
+            if(this == &other)
+                return *this;
+            close();
+            fd_ = std::exchange(other.fd_, -1);
+            region_ = std::exchange(other.region_, nullptr);
+            region_size_ = std::exchange(other.region_size_, 0);
+            header_ = std::exchange(other.header_, nullptr);
+            stamps_ = std::exchange(other.stamps_, nullptr);
+            messages_ = std::exchange(other.messages_, nullptr);
+            capacity_ = std::exchange(other.capacity_, 0);
+            index_mask_ = std::exchange(other.index_mask_, 0);
+            consumer_cache_ = std::exchange(other.consumer_cache_, 0);
+            return *this;
+        }
+
+
+        // Creates a named queue, fails when the name is taken
+        static shared_queue create(char const* name, size_type capacity) {
+            int const fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+            if(fd == -1)
+                return shared_queue {};
+            auto queue = create_in(fd, capacity);
+            if(!queue)
+                shm_unlink(name);
+            return queue;
+        }
+
+
+        // Creates an unnamed queue, its descriptor is inherited
+        // by child processes or passed over a unix socket
+        static shared_queue create_anonymous(size_type capacity) {
+            int const fd = memfd_create("hydra", 0);
+            if(fd == -1)
+                return shared_queue {};
+            return create_in(fd, capacity);
+        }
+
+
+        // Fails when the queue is not created yet or was created
+        // by another version or for other messages
+        static shared_queue attach(char const* name) {
+            int const fd = shm_open(name, O_RDWR, 0);
+            if(fd == -1)
+                return shared_queue {};
+            return attach_to(fd);
+        }
+
+
+        // Descriptor is duplicated, the caller keeps its own
+        static shared_queue attach(int fd) {
+            int const duplicate = dup(fd);
+            if(duplicate == -1)
+                return shared_queue {};
+            return attach_to(duplicate);
+        }
+
+
+        // Name is released, attached processes keep the region
+        static bool remove(char const* name) noexcept {
+            return shm_unlink(name) == 0;
+        }
+
+
+        explicit operator bool() const noexcept { return header_ != nullptr; }
+        int fd() const noexcept { return fd_; }
+        size_type capacity() const noexcept { return capacity_; }
+        T& operator[](sequence n) noexcept {
+            return messages_[n.value() & index_mask_];
+        }
+        T const& operator[](sequence n) const noexcept {
+            return messages_[n.value() & index_mask_];
+        }
+
+
+        size_type size() const noexcept {
+            if(!header_)
+                return 0;
+            auto const c = header_->consumer.load(std::memory_order_relaxed);
+            auto const p = header_->producer.load(std::memory_order_relaxed);
+            return p - c;
+        }
+
+
+        // Waits for room in the queue with the given strategy
+        template<typename W = yielding_wait>
+        sequence claim(W const& wait = W {}) noexcept {
+            if(!header_)
+                return sequence {};
+
+            sequence_value p;
+            if constexpr(Kind == shared_queue_kind::spsc) {
+                p = header_->producer.load(std::memory_order_relaxed);
+                header_->producer.store(p + 1, std::memory_order_relaxed);
+            } else {
+                p = header_->producer.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            if(!fits(p))
+                wait.wait_until([this, p] { return fits(p); });
+            return sequence {p};
+        }
+
+
+        // Wakes the consumer process when it is parked
+        void publish(sequence n) noexcept {
+            stamps_[n.value() & index_mask_].store(n.value() + 1,
+                                                   std::memory_order_release);
+            header_->published.notify_one();
+        }
+
+
+        sequence try_fetch() noexcept {
+            if(!header_)
+                return sequence {};
+
+            auto const c = header_->consumer.load(std::memory_order_relaxed);
+            if(stamps_[c & index_mask_].load(std::memory_order_acquire)
+               != c + 1)
+                return sequence {};
+
+            return sequence {c};
+        }
+
+
+        // Whether the message at consumer cursor is published
+        bool ready() noexcept { return !!try_fetch(); }
+
+
+        // Waits for a message with the given strategy,
+        // blocking_wait parks the consumer on a process-shared futex
+        template<typename W = blocking_wait>
+        sequence fetch(W const& wait = W {}) noexcept {
+            if(!header_)
+                return sequence {};
+            wait.wait_until(header_->published, [this] { return ready(); });
+            return try_fetch();
+        }
+
+
+        void fetched() noexcept {
+            auto const c = header_->consumer.load(std::memory_order_relaxed);
+            header_->consumer.store(c + 1, std::memory_order_release);
+        }
+
+    private:
+        // Rereads consumer cursor only when the cached one says
+        // there is no room for p
+        bool fits(sequence_value p) noexcept {
+            if(p - consumer_cache_ < capacity_)
+                return true;
+            consumer_cache_ = header_->consumer.load(std::memory_order_acquire);
+            return p - consumer_cache_ < capacity_;
+        }
+
+
+        void close() noexcept {
+            if(region_ != nullptr)
+                munmap(region_, region_size_);
+            if(fd_ != -1)
+                ::close(fd_);
+            fd_ = -1;
+            region_ = nullptr;
+            region_size_ = 0;
+            header_ = nullptr;
+            stamps_ = nullptr;
+            messages_ = nullptr;
+            capacity_ = 0;
+            index_mask_ = 0;
+            consumer_cache_ = 0;
+        }
+
+
+        static std::size_t round_up(std::size_t n, std::size_t alignment) {
+            return (n + alignment - 1) / alignment * alignment;
+        }
+
+
+        // Maps the region and points handle into it, takes the descriptor
+        static shared_queue map(int fd, std::size_t region_size) {
+            shared_queue queue;
+            queue.fd_ = fd;
+            void* const p = mmap(nullptr,
+                                 region_size,
+                                 PROT_READ | PROT_WRITE,
+                                 MAP_SHARED,
+                                 fd,
+                                 0);
+            if(p == MAP_FAILED) {
+                queue.close();
+                return queue;
+            }
+            queue.region_ = static_cast<std::byte*>(p);
+            queue.region_size_ = region_size;
+            return queue;
+        }
+
+
+        void point(shared_queue_header* header) noexcept {
+            header_ = header;
+            stamps_ = reinterpret_cast<stamp_type*>(region_
+                                                    + header->stamps_offset);
+            messages_ = reinterpret_cast<T*>(region_ + header->messages_offset);
+            capacity_ = size_type(header->capacity);
+            index_mask_ = capacity_ - 1;
+        }
+
+
+        static shared_queue create_in(int fd, size_type capacity) {
+            auto const count = std::size_t(std::bit_ceil(
+                std::uint64_t((std::max)(capacity, size_type(2)))));
+            auto const stamps_offset =
+                round_up(sizeof(shared_queue_header), cacheline_size);
+            auto const messages_offset =
+                round_up(stamps_offset + count * sizeof(stamp_type),
+                         cacheline_size);
+            auto const region_size = messages_offset + count * sizeof(T);
+
+            if(ftruncate(fd, off_t(region_size)) == -1) {
+                ::close(fd);
+                return shared_queue {};
+            }
+
+            auto queue = map(fd, region_size);
+            if(!queue.region_)
+                return queue;
+
+            auto* const header = ::new(static_cast<void*>(queue.region_))
+                shared_queue_header {};
+            header->magic = shared_queue_header::magic_value;
+            header->version = shared_queue_header::current_version;
+            header->kind = Kind;
+            header->capacity = count;
+            header->element_size = sizeof(T);
+            header->element_alignment = alignof(T);
+            header->stamps_offset = stamps_offset;
+            header->messages_offset = messages_offset;
+            header->region_size = region_size;
+            std::uninitialized_value_construct_n(
+                reinterpret_cast<stamp_type*>(queue.region_ + stamps_offset),
+                count);
+            queue.point(header);
+            header->ready.store(1, std::memory_order_release);
+            return queue;
+        }
+
+
+        // Region may be corrupt or written by a hostile process,
+        // so the layout is checked before any index is derived from it
+        static bool valid_layout(shared_queue_header const& header) noexcept {
+            auto const capacity = header.capacity;
+            auto const stamps = header.stamps_offset;
+            auto const messages = header.messages_offset;
+            auto const region = header.region_size;
+            auto const max_capacity =
+                region / (sizeof(stamp_type) + sizeof(T));
+            return capacity >= 2
+                   && std::has_single_bit(capacity)
+                   && capacity <= max_capacity
+                   && stamps % cacheline_size == 0
+                   && messages % cacheline_size == 0
+                   && stamps >= sizeof(shared_queue_header)
+                   && stamps <= messages
+                   && capacity * sizeof(stamp_type) <= messages - stamps
+                   && messages <= region
+                   && capacity * sizeof(T) <= region - messages;
+        }
+
+
+        static shared_queue attach_to(int fd) {
+            struct stat status;
+            if(fstat(fd, &status) == -1
+               || std::size_t(status.st_size) < sizeof(shared_queue_header)) {
+                ::close(fd);
+                return shared_queue {};
+            }
+
+            auto queue = map(fd, std::size_t(status.st_size));
+            if(!queue.region_)
+                return queue;
+
+            auto* const header = std::launder(
+                reinterpret_cast<shared_queue_header*>(queue.region_));
+            bool const valid =
+                header->ready.load(std::memory_order_acquire) == 1
+                && header->magic == shared_queue_header::magic_value
+                && header->version == shared_queue_header::current_version
+                && header->kind == Kind
+                && header->element_size == sizeof(T)
+                && header->element_alignment == alignof(T)
+                && header->region_size <= queue.region_size_
+                && valid_layout(*header);
+            if(!valid) {
+                queue.close();
+                return queue;
+            }
+
+            queue.point(header);
+            return queue;
+        }
+    };   // shared_queue
+
+
+    template<typename T>
+    using shared_spsc_queue = shared_queue<T, shared_queue_kind::spsc>;
+
+    template<typename T>
+    using shared_mpsc_queue = shared_queue<T, shared_queue_kind::mpsc>;
+
+
+}   // namespace hydra
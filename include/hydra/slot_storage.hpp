@@ -0,0 +1,319 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include <hydra/cacheline.hpp>
+#include <hydra/ring_memory.hpp>
+#include <hydra/sequence.hpp>
+
+
+namespace hydra {
+
+
+    enum class slot_lifetime {
+        // Slots are default constructed by reserve and reused
+        persistent,
+        // Messages are constructed on claim and destroyed when fetched
+        per_message
+    };   // slot_lifetime
+
+
+    // Values and publication stamps of a ring in separate arrays
+    // of a single block, stamps go first
+    template<typename T, slot_lifetime Lifetime = slot_lifetime::persistent>
+    class separate_slots {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = T;
+        using stamp_type = std::atomic<sequence::value_type>;
+
+        static constexpr slot_lifetime lifetime = Lifetime;
+        static constexpr bool contiguous = true;
+        static constexpr size_type stamps_per_line =
+            size_type(cacheline_size / sizeof(stamp_type));
+
+        static_assert(alignof(T) <= ring_memory::alignment);
+
+    private:
+        struct cell {
+            alignas(T) std::byte bytes[sizeof(T)];
+        };   // cell
+
+        using value_storage = std::conditional_t<
+            Lifetime == slot_lifetime::persistent, T, cell>;
+
+        ring_memory block_;
+        value_storage* values_ {nullptr};
+        size_type capacity_ {0};
+        memory_options memory_;
+
+    public:
+        separate_slots() noexcept = default;
+        separate_slots(separate_slots const&) = delete;
+        separate_slots& operator=(separate_slots const&) = delete;
+        ~separate_slots() { destroy_values(); }
+        explicit operator bool() const noexcept { return !!block_; }
+
+
+        separate_slots(separate_slots&& other) noexcept
+            : block_ {std::move(other.block_)}
+            , values_ {std::exchange(other.values_, nullptr)}
+            , capacity_ {std::exchange(other.capacity_, 0)}
+            , memory_ {other.memory_} {}
+
+
+        separate_slots& operator=(separate_slots&& other) noexcept {
+            if(this == &other)
+                return *this;
+            destroy_values();
+            block_ = std::move(other.block_);
+            values_ = std::exchange(other.values_, nullptr);
+            capacity_ = std::exchange(other.capacity_, 0);
+            memory_ = other.memory_;
+            return *this;
+        }
+
+
+        // Published messages are to be destroyed by the owner
+        // before the storage goes away
+        void reserve(size_type capacity, memory_options const& memory = {}) {
+            destroy_values();
+            auto const count = std::size_t(capacity);
+            auto const stamps_bytes = (count * sizeof(stamp_type)
+                                       + ring_memory::alignment - 1)
+                                      / ring_memory::alignment
+                                      * ring_memory::alignment;
+            block_ = ring_memory {stamps_bytes + count * sizeof(value_storage),
+                                  memory};
+            memory_ = memory;
+            std::uninitialized_value_construct_n(stamps(), count);
+            auto* const values =
+                reinterpret_cast<value_storage*>(block_.data() + stamps_bytes);
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                std::uninitialized_value_construct_n(values, count);
+            else
+                std::uninitialized_default_construct_n(values, count);
+            values_ = values;
+            capacity_ = capacity;
+        }
+
+
+        memory_options const& memory() const noexcept { return memory_; }
+
+
+        T& value(size_type index) noexcept {
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                return values_[index];
+            else
+                return *std::launder(
+                    reinterpret_cast<T*>(values_[index].bytes));
+        }
+
+
+        T const& value(size_type index) const noexcept {
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                return values_[index];
+            else
+                return *std::launder(
+                    reinterpret_cast<T const*>(values_[index].bytes));
+        }
+
+
+        // Values are contiguous, so a run of slots is a span
+        T* values() noexcept { return &value(0); }
+
+
+        stamp_type& stamp(size_type index) noexcept {
+            return stamps()[index];
+        }
+
+
+        template<typename... Args>
+        void construct(size_type index, Args&&... args) {
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                values_[index] = T(std::forward<Args>(args)...);
+            else
+                ::new(static_cast<void*>(values_[index].bytes))
+                    T(std::forward<Args>(args)...);
+        }
+
+
+        void destroy(size_type index) noexcept {
+            if constexpr(Lifetime == slot_lifetime::per_message
+                         && !std::is_trivially_destructible_v<T>)
+                value(index).~T();
+        }
+
+    private:
+        stamp_type* stamps() const noexcept {
+            return std::launder(reinterpret_cast<stamp_type*>(block_.data()));
+        }
+
+
+        void destroy_values() noexcept {
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                if(values_ != nullptr)
+                    std::destroy_n(values_, std::size_t(capacity_));
+            values_ = nullptr;
+            capacity_ = 0;
+        }
+    };   // separate_slots
+
+
+    // Stamp and value of a slot side by side, so a consumer touches
+    // a single cache line per small message; values are not contiguous
+    // and fetch_available is not available
+    template<typename T, slot_lifetime Lifetime = slot_lifetime::persistent>
+    class interleaved_slots {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = T;
+        using stamp_type = std::atomic<sequence::value_type>;
+
+        static constexpr slot_lifetime lifetime = Lifetime;
+        static constexpr bool contiguous = false;
+
+    private:
+        struct cell {
+            alignas(T) std::byte bytes[sizeof(T)];
+        };   // cell
+
+        using value_storage = std::conditional_t<
+            Lifetime == slot_lifetime::persistent, T, cell>;
+
+        struct packed_slot {
+            stamp_type stamp;
+            value_storage value;
+        };   // packed_slot
+
+        // Slots smaller than a cache line are padded to a power of 2
+        // and aligned to it, so no slot straddles two lines
+        static constexpr std::size_t slot_alignment = (std::max)(
+            (std::min)(std::bit_ceil(sizeof(packed_slot)), cacheline_size),
+            alignof(packed_slot));
+
+        struct alignas(slot_alignment) slot {
+            stamp_type stamp {0};
+            value_storage value;
+        };   // slot
+
+        static_assert(alignof(slot) <= ring_memory::alignment);
+
+        ring_memory block_;
+        size_type capacity_ {0};
+        memory_options memory_;
+
+    public:
+        static constexpr size_type stamps_per_line = size_type(
+            sizeof(slot) < cacheline_size ? cacheline_size / sizeof(slot)
+                                          : 1);
+
+        // Queues scan stamps line by line assuming lines hold whole slots
+        static_assert(sizeof(slot) >= cacheline_size
+                      || sizeof(slot) * std::size_t(stamps_per_line)
+                             == cacheline_size);
+
+        interleaved_slots() noexcept = default;
+        interleaved_slots(interleaved_slots const&) = delete;
+        interleaved_slots& operator=(interleaved_slots const&) = delete;
+        ~interleaved_slots() { destroy_slots(); }
+        explicit operator bool() const noexcept { return !!block_; }
+
+
+        interleaved_slots(interleaved_slots&& other) noexcept
+            : block_ {std::move(other.block_)}
+            , capacity_ {std::exchange(other.capacity_, 0)}
+            , memory_ {other.memory_} {}
+
+
+        interleaved_slots& operator=(interleaved_slots&& other) noexcept {
+            if(this == &other)
+                return *this;
+            destroy_slots();
+            block_ = std::move(other.block_);
+            capacity_ = std::exchange(other.capacity_, 0);
+            memory_ = other.memory_;
+            return *this;
+        }
+
+
+        // Published messages are to be destroyed by the owner
+        // before the storage goes away
+        void reserve(size_type capacity, memory_options const& memory = {}) {
+            destroy_slots();
+            auto const count = std::size_t(capacity);
+            block_ = ring_memory {count * sizeof(slot), memory};
+            memory_ = memory;
+            std::uninitialized_value_construct_n(slots(), count);
+            capacity_ = capacity;
+        }
+
+
+        memory_options const& memory() const noexcept { return memory_; }
+
+
+        T& value(size_type index) noexcept {
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                return slots()[index].value;
+            else
+                return *std::launder(
+                    reinterpret_cast<T*>(slots()[index].value.bytes));
+        }
+
+
+        T const& value(size_type index) const noexcept {
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                return slots()[index].value;
+            else
+                return *std::launder(
+                    reinterpret_cast<T const*>(slots()[index].value.bytes));
+        }
+
+
+        stamp_type& stamp(size_type index) noexcept {
+            return slots()[index].stamp;
+        }
+
+
+        template<typename... Args>
+        void construct(size_type index, Args&&... args) {
+            if constexpr(Lifetime == slot_lifetime::persistent)
+                slots()[index].value = T(std::forward<Args>(args)...);
+            else
+                ::new(static_cast<void*>(slots()[index].value.bytes))
+                    T(std::forward<Args>(args)...);
+        }
+
+
+        void destroy(size_type index) noexcept {
+            if constexpr(Lifetime == slot_lifetime::per_message
+                         && !std::is_trivially_destructible_v<T>)
+                value(index).~T();
+        }
+
+    private:
+        slot* slots() const noexcept {
+            return std::launder(reinterpret_cast<slot*>(block_.data()));
+        }
+
+
+        void destroy_slots() noexcept {
+            if(block_)
+                std::destroy_n(slots(), std::size_t(capacity_));
+            capacity_ = 0;
+        }
+    };   // interleaved_slots
+
+}   // namespace hydra
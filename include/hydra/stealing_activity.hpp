@@ -0,0 +1,210 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <hydra/batch.hpp>
+#include <hydra/futex_event.hpp>
+#include <hydra/mpmc_queue.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    // Sharded activity: each worker owns a shard, producers publish to
+    // shards, idle workers steal up to a half of a busy shard at once.
+    // Messages of a shard may be processed out of order when stolen
+    template<typename M,
+             typename Q = mpmc_queue<M>,
+             typename W = blocking_wait>
+    class stealing_activity {
+    public:
+        using message_type = M;
+        using queue_type = Q;
+        using wait_strategy = W;
+        using size_type = typename Q::size_type;
+        using batch_type = batch<Q>;
+
+        static_assert(shared_consumer_queue<Q>,
+                      "stealing_activity needs a queue with several consumers");
+
+        // Producer side of a shard with the API of activity
+        class shard_type {
+        public:
+            shard_type() noexcept = default;
+            shard_type(shard_type const&) = delete;
+            shard_type& operator=(shard_type const&) = delete;
+
+            sequence claim() noexcept { return messages_.claim(owner_->wait_); }
+            sequence_range claim_n(size_type count) noexcept {
+                return messages_.claim_n(count, owner_->wait_);
+            }
+            message_type& operator[](sequence n) noexcept {
+                return messages_[n];
+            }
+            size_type size() const noexcept { return messages_.size(); }
+
+            template<typename Rep, typename Period>
+            sequence claim_for(
+                std::chrono::duration<Rep, Period> const& duration) noexcept {
+                return messages_.claim_for(duration, owner_->wait_);
+            }
+
+
+            void publish(sequence n) noexcept {
+                messages_.publish(n);
+                owner_->new_message_.notify_one();
+            }
+
+
+            void publish_range(sequence first, sequence last) noexcept {
+                messages_.publish_range(first, last);
+                owner_->new_message_.notify_one();
+            }
+
+
+            void publish_range(sequence_range const& range) noexcept {
+                publish_range(range.first(), range.last());
+            }
+
+        private:
+            friend class stealing_activity;
+
+            queue_type messages_;
+            stealing_activity* owner_ {nullptr};
+        };   // shard_type
+
+    private:
+        std::size_t shards_count_;
+        std::unique_ptr<shard_type[]> shards_;
+        std::vector<std::thread> workers_;
+        // Any worker can serve any shard, so they share one event
+        futex_event new_message_;
+        std::atomic<std::uint64_t> steals_count_ {0};
+        std::atomic_flag stopping_ {};
+        wait_strategy wait_;
+
+    public:
+        explicit stealing_activity(std::size_t shards_count,
+                                   wait_strategy wait = wait_strategy {})
+            : shards_count_ {shards_count},
+              shards_ {std::make_unique<shard_type[]>(shards_count)},
+              wait_ {wait} {
+            for(std::size_t i = 0; i != shards_count_; ++i)
+                shards_[i].owner_ = this;
+        }
+
+        stealing_activity(stealing_activity const&) noexcept = delete;
+        stealing_activity& operator=(stealing_activity const&) noexcept =
+            delete;
+        ~stealing_activity() { stop(); }
+        bool active() const noexcept { return !workers_.empty(); }
+        std::size_t shards_count() const noexcept { return shards_count_; }
+        shard_type& shard(std::size_t n) noexcept { return shards_[n]; }
+        std::uint64_t steals_count() const noexcept {
+            return steals_count_.load(std::memory_order_relaxed);
+        }
+
+
+        // Reserves capacity of each shard
+        void reserve(size_type n) {
+            for(std::size_t i = 0; i != shards_count_; ++i)
+                shards_[i].messages_.reserve(n);
+        }
+
+
+        // Workers drain all shards before exit
+        void stop() noexcept {
+            if(workers_.empty()
+               || stopping_.test_and_set(std::memory_order_release))
+                return;
+            new_message_.notify_all();
+            for(auto& worker: workers_)
+                worker.join();
+            workers_.clear();
+            stopping_.clear(std::memory_order_relaxed);
+        }
+
+
+        // Starts one worker per shard
+        template<typename H>
+        bool run(H&& handler) {
+            if(!workers_.empty() || shards_count_ == 0 || !shards_[0].messages_)
+                return false;
+
+            workers_.reserve(shards_count_);
+            for(std::size_t i = 0; i != shards_count_; ++i)
+                workers_.emplace_back([handler, this, i]() mutable {
+                    work(handler, i);
+                });
+
+            return true;
+        }
+
+
+    private:
+        bool any_ready() noexcept {
+            for(std::size_t i = 0; i != shards_count_; ++i)
+                if(shards_[i].messages_.ready())
+                    return true;
+            return false;
+        }
+
+
+        // Runs handler over own shard or steals from the next ready one,
+        // returns number of processed messages or -1 if nothing was ready
+        template<typename H>
+        std::int64_t serve(H& handler, std::size_t own) {
+            auto& messages = shards_[own].messages_;
+            if(messages.ready()) {
+                auto own_batch = batch<Q> {messages};
+                handler(own_batch);
+                return own_batch.fetched_count();
+            }
+
+            for(std::size_t i = 1; i != shards_count_; ++i) {
+                auto& victim = shards_[(own + i) % shards_count_].messages_;
+                if(!victim.ready())
+                    continue;
+                auto stolen = batch<Q> {victim, victim.size() / 2 + 1};
+                handler(stolen);
+                if(stolen.fetched_count() != 0)
+                    steals_count_.fetch_add(1, std::memory_order_relaxed);
+                return stolen.fetched_count();
+            }
+
+            return -1;
+        }
+
+
+        template<typename H>
+        void work(H& handler, std::size_t own) {
+            for(;;) {
+                wait_.wait_until(new_message_, [this] {
+                    return any_ready()
+                           || stopping_.test(std::memory_order_acquire);
+                });
+
+                bool const stopping = stopping_.test(std::memory_order_acquire);
+                auto const processed = serve(handler, own);
+                if(processed > 0 || (processed == 0 && !stopping))
+                    continue;
+
+                if(stopping)
+                    break;
+            }
+        }
+
+    };   // stealing_activity
+
+
+}   // namespace hydra
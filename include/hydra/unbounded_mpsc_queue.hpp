@@ -0,0 +1,391 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+#include <hydra/cacheline.hpp>
+#include <hydra/ring_span.hpp>
+#include <hydra/sequence.hpp>
+#include <hydra/wait_strategy.hpp>
+
+
+namespace hydra {
+
+
+    // Never blocks producers: messages live in linked segments of
+    // SegmentSize slots, consumed segments are recycled through a free list.
+    // A consumed segment is stamped with the producer cursor once head
+    // and tail are past it: later claims cannot reach it, and earlier ones
+    // are published when the consumer passes the stamp, so the segment
+    // is recycled then and no producer sees it reused under it
+    template<typename T, std::size_t SegmentSize = 1024>
+    class unbounded_mpsc_queue {
+    public:
+        using size_type = sequence::value_type;
+        using value_type = T;
+
+        static_assert(SegmentSize >= 2
+                          && (SegmentSize & (SegmentSize - 1)) == 0,
+                      "SegmentSize should be a power of two");
+
+    private:
+        using sequence_value = sequence::value_type;
+
+        static constexpr auto segment_size = sequence_value(SegmentSize);
+        static constexpr auto index_mask = segment_size - 1;
+
+        struct segment {
+            std::atomic<sequence_value> base {0};
+            std::atomic<segment*> next {nullptr};
+            // Links of free and retired lists
+            std::atomic<segment*> next_free {nullptr};
+            // Producer cursor when retired segment became unreachable,
+            // consumer-owned
+            sequence_value retired_at {0};
+            std::atomic<sequence_value> published[SegmentSize] {};
+            T pool[SegmentSize];
+
+            segment* bounds(sequence_value n) noexcept {
+                auto const first = base.load(std::memory_order_relaxed);
+                return n >= first && n - first < segment_size ? this : nullptr;
+            }
+        };   // segment
+
+        // Producer-owned
+        alignas(cacheline_size) std::atomic<sequence_value> producer_ {0};
+        std::atomic<segment*> tail_ {nullptr};
+        std::atomic<std::int64_t> segments_count_ {0};
+        // Consumer-owned
+        alignas(cacheline_size) std::atomic<sequence_value> consumer_ {0};
+        std::atomic<segment*> head_ {nullptr};
+        segment* retired_ {nullptr};
+        // Recycled segments
+        alignas(cacheline_size) std::atomic<segment*> free_ {nullptr};
+
+    public:
+        unbounded_mpsc_queue() noexcept = default;
+        unbounded_mpsc_queue(unbounded_mpsc_queue const&) = delete;
+        unbounded_mpsc_queue& operator=(unbounded_mpsc_queue const&) = delete;
+        unbounded_mpsc_queue(size_type capacity) { reserve(capacity); }
+        explicit operator bool() noexcept { return !!head_.load(); }
+        // Producers are never blocked
+        size_type blocks_count() const noexcept { return 0; }
+        std::chrono::nanoseconds blocked_time() const noexcept {
+            return std::chrono::nanoseconds {0};
+        }
+        void park_producers(size_type) noexcept {}
+        size_type size() const noexcept {
+            return producer_.load(std::memory_order_relaxed)
+                   - consumer_.load(std::memory_order_relaxed);
+        }
+        // Segments allocated from the heap so far
+        std::int64_t segments_count() const noexcept {
+            return segments_count_.load(std::memory_order_relaxed);
+        }
+
+
+        ~unbounded_mpsc_queue() {
+            for(auto* s = head_.load(); s != nullptr;)
+                delete std::exchange(s, s->next.load());
+            for(auto* s = retired_; s != nullptr;)
+                delete std::exchange(s, s->next_free.load());
+            for(auto* s = free_.load(); s != nullptr;)
+                delete std::exchange(s, s->next_free.load());
+        }
+
+
+        // Preallocates segments for capacity messages,
+        // should be called before the first claim
+        void reserve(size_type capacity) {
+            if(!head_.load()) {
+                auto* first = allocate(consumer_.load());
+                head_.store(first);
+                tail_.store(first);
+            }
+            for(size_type n = segment_size; n < capacity; n += segment_size) {
+                auto* s = new segment;
+                segments_count_.fetch_add(1, std::memory_order_relaxed);
+                recycle(s);
+            }
+        }
+
+
+        T& operator[](sequence n) noexcept {
+            return locate(n.value())->pool[n.value() & index_mask];
+        }
+
+
+        template<typename W = yielding_wait>
+        sequence claim(W const& = W {}) noexcept {
+            if(!head_.load(std::memory_order_relaxed))
+                return sequence {};
+
+            sequence const p {
+                producer_.fetch_add(1, std::memory_order_seq_cst)};
+            locate(p.value());
+            return p;
+        }
+
+
+        // Claims of an unbounded queue never wait, so this never times
+        // out and the duration is ignored; kept for the queue interface
+        // used by activity
+        template<typename Rep, typename Period, typename W = yielding_wait>
+        sequence claim_for(std::chrono::duration<Rep, Period> const&,
+                           W const& wait = W {}) noexcept {
+            return claim(wait);
+        }
+
+
+        // Claims count contiguous sequences at once
+        template<typename W = yielding_wait>
+        sequence_range claim_n(size_type count, W const& = W {}) noexcept {
+            if(!head_.load(std::memory_order_relaxed) || count <= 0)
+                return sequence_range {};
+
+            sequence const first {
+                producer_.fetch_add(count, std::memory_order_seq_cst)};
+            sequence const last {first.value() + count};
+            locate(last.value() - 1);
+            return sequence_range {first, last};
+        }
+
+
+        void publish(sequence n) noexcept {
+            locate(n.value())
+                ->published[n.value() & index_mask]
+                .store(n.value() + 1, std::memory_order_release);
+        }
+
+
+        // Publishes sequences [first, last)
+        void publish_range(sequence first, sequence last) noexcept {
+            auto* s = locate(first.value());
+            for(auto n = first.value(); n != last.value(); ++n) {
+                if(!s->bounds(n))
+                    s = s->next.load(std::memory_order_acquire);
+                s->published[n & index_mask].store(n + 1,
+                                                   std::memory_order_release);
+            }
+        }
+
+
+        void publish_range(sequence_range const& range) noexcept {
+            publish_range(range.first(), range.last());
+        }
+
+
+        sequence try_fetch() noexcept {
+            auto* const s = current();
+            if(!s)
+                return sequence {};
+
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            if(s->published[c & index_mask].load(std::memory_order_acquire)
+               != c + 1) {
+                reclaim();
+                return sequence {};
+            }
+
+            return sequence {c};
+        }
+
+
+        bool ready() noexcept { return !!try_fetch(); }
+
+
+        void fetched() noexcept {
+            consumer_.store(consumer_.load(std::memory_order_relaxed) + 1,
+                            std::memory_order_release);
+        }
+
+
+        // Returns up to max published messages of the current segment
+        ring_span<T> fetch_available(size_type max) noexcept {
+            auto* const s = current();
+            if(!s || max <= 0)
+                return ring_span<T> {};
+
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            auto const last = (std::min)(
+                c + max,
+                s->base.load(std::memory_order_relaxed) + segment_size);
+            auto n = c;
+            while(n != last
+                  && s->published[n & index_mask].load(
+                         std::memory_order_acquire)
+                         == n + 1)
+                ++n;
+            if(n == c)
+                reclaim();
+
+            return ring_span<T> {
+                std::span<T> {&s->pool[c & index_mask], std::size_t(n - c)},
+                std::span<T> {},
+                sequence {c}};
+        }
+
+
+        void fetched(size_type count) noexcept {
+            consumer_.store(consumer_.load(std::memory_order_relaxed) + count,
+                            std::memory_order_release);
+        }
+
+
+    private:
+        // Segment of consumer cursor, retires the consumed one
+        segment* current() noexcept {
+            auto* s = head_.load(std::memory_order_relaxed);
+            if(!s)
+                return nullptr;
+
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            if(s->bounds(c))
+                return s;
+
+            auto* const next = s->next.load(std::memory_order_acquire);
+            if(!next)
+                return s;
+
+            head_.store(next, std::memory_order_seq_cst);
+            s->retired_at = 0;
+            s->next_free.store(retired_, std::memory_order_relaxed);
+            retired_ = s;
+            reclaim();
+            return next;
+        }
+
+
+        // Recycles retired segments once no producer can hold them.
+        // A producer reaches segments from head or tail loaded after its
+        // claim, so claims after the stamp start past the segment, and
+        // claims before it are published when the consumer passes it
+        void reclaim() noexcept {
+            if(!retired_)
+                return;
+            auto const c = consumer_.load(std::memory_order_relaxed);
+            auto const tail_base = tail_.load(std::memory_order_seq_cst)
+                                       ->base.load(std::memory_order_relaxed);
+            segment* kept = nullptr;
+            for(auto* s = std::exchange(retired_, nullptr); s != nullptr;) {
+                auto* const next = s->next_free.load(std::memory_order_relaxed);
+                if(s->retired_at == 0
+                   && tail_base > s->base.load(std::memory_order_relaxed))
+                    s->retired_at = producer_.load(std::memory_order_seq_cst);
+                if(s->retired_at != 0 && c >= s->retired_at) {
+                    recycle(s);
+                } else {
+                    s->next_free.store(kept, std::memory_order_relaxed);
+                    kept = s;
+                }
+                s = next;
+            }
+            retired_ = kept;
+        }
+
+
+        void recycle(segment* s) noexcept {
+            auto* top = free_.load(std::memory_order_relaxed);
+            do {
+                s->next_free.store(top, std::memory_order_relaxed);
+            } while(!free_.compare_exchange_weak(top,
+                                                 s,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+        }
+
+
+        // Pops a recycled segment or allocates a new one
+        segment* allocate(sequence_value base) {
+            auto* s = free_.load(std::memory_order_acquire);
+            while(s
+                  && !free_.compare_exchange_weak(
+                      s,
+                      s->next_free.load(std::memory_order_relaxed),
+                      std::memory_order_acquire,
+                      std::memory_order_acquire))
+                ;
+            if(!s) {
+                s = new segment;
+                segments_count_.fetch_add(1, std::memory_order_relaxed);
+            }
+            s->next.store(nullptr, std::memory_order_relaxed);
+            s->base.store(base, std::memory_order_relaxed);
+            return s;
+        }
+
+
+        // Finds segment of n linking new segments when needed,
+        // starts from the newest segment or from the consumer one
+        segment* locate(sequence_value n) noexcept {
+            auto* s = tail_.load(std::memory_order_seq_cst);
+            if(s->base.load(std::memory_order_relaxed) > n)
+                s = head_.load(std::memory_order_seq_cst);
+
+            segment* spare = nullptr;
+            while(!s->bounds(n)) {
+                auto* next = s->next.load(std::memory_order_acquire);
+                if(!next) {
+                    auto const base =
+                        s->base.load(std::memory_order_relaxed) + segment_size;
+                    if(!spare)
+                        spare = allocate(base);
+                    spare->base.store(base, std::memory_order_relaxed);
+                    if(s->next.compare_exchange_strong(
+                           next,
+                           spare,
+                           std::memory_order_acq_rel,
+                           std::memory_order_acquire)) {
+                        next = std::exchange(spare, nullptr);
+                        advance_tail(next);
+                    }
+                }
+                s = next;
+            }
+
+            // Other producer has linked its segment first, ours goes next
+            while(spare) {
+                auto* last = s;
+                for(auto* next = last->next.load(std::memory_order_acquire);
+                    next;
+                    next = last->next.load(std::memory_order_acquire))
+                    last = next;
+                spare->base.store(
+                    last->base.load(std::memory_order_relaxed) + segment_size,
+                    std::memory_order_relaxed);
+                segment* expected = nullptr;
+                if(last->next.compare_exchange_strong(
+                       expected,
+                       spare,
+                       std::memory_order_acq_rel,
+                       std::memory_order_relaxed))
+                    advance_tail(std::exchange(spare, nullptr));
+            }
+
+            return s;
+        }
+
+
+        void advance_tail(segment* s) noexcept {
+            auto const base = s->base.load(std::memory_order_relaxed);
+            auto* tail = tail_.load(std::memory_order_acquire);
+            while(tail->base.load(std::memory_order_relaxed) < base
+                  && !tail_.compare_exchange_weak(tail,
+                                                  s,
+                                                  std::memory_order_seq_cst,
+                                                  std::memory_order_acquire))
+                ;
+        }
+    };   // unbounded_mpsc_queue
+
+
+}   // namespace hydra
@@ -0,0 +1,182 @@
+// This file is part of hydra library
+// Copyright 2020-2022 Andrei Ilin <ortfero@gmail.com>
+// SPDX-License-Identifier: MIT
+
+#pragma once
+
+
+#include <chrono>
+#include <thread>
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif
+
+#include <hydra/futex_event.hpp>
+
+
+// Wait strategies are used by consumers waiting for new messages and
+// by producers waiting for room in a queue. Each strategy provides
+//
+//   wait_until(ready)        - nobody signals readiness, only polling
+//   wait_until(event, ready) - whoever makes ready() true notifies event
+//
+// Both return when ready() returns true.
+
+
+namespace hydra {
+
+
+    inline void cpu_relax() noexcept {
+#if defined(_MSC_VER)
+
+#    if defined(_M_AMD64) || defined(_M_IX86)
+        _mm_pause();
+#    elif defined(_M_ARM) || defined(_M_ARM64)
+        __yield();
+#    endif
+
+#else
+
+#    if defined(__x86_64__) || defined(__i386__)
+        __asm__ __volatile__("pause");
+#    elif defined(__arm__) || defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#    endif
+
+#endif
+    }
+
+
+    // Lowest latency, burns a core while waiting
+    struct busy_spin_wait {
+        template<typename F>
+        void wait_until(F&& ready) const noexcept {
+            while(!ready())
+                cpu_relax();
+        }
+
+
+        template<futex_scope Scope, typename F>
+        void wait_until(basic_futex_event<Scope>&,
+                        F&& ready) const noexcept {
+            wait_until(ready);
+        }
+    };   // busy_spin_wait
+
+
+    // Spins for a while, then gives up the time slice on each poll
+    struct yielding_wait {
+        unsigned spins {100};
+
+        template<typename F>
+        void wait_until(F&& ready) const noexcept {
+            for(unsigned i = 0; i != spins; ++i) {
+                if(ready())
+                    return;
+                cpu_relax();
+            }
+
+            while(!ready())
+                std::this_thread::yield();
+        }
+
+
+        template<futex_scope Scope, typename F>
+        void wait_until(basic_futex_event<Scope>&,
+                        F&& ready) const noexcept {
+            wait_until(ready);
+        }
+    };   // yielding_wait
+
+
+    // Spins, yields, then polls with sleeps of the given period
+    struct sleeping_wait {
+        unsigned spins {100};
+        unsigned yields {100};
+        std::chrono::nanoseconds period {std::chrono::microseconds {50}};
+
+        template<typename F>
+        void wait_until(F&& ready) const noexcept {
+            for(unsigned i = 0; i != spins; ++i) {
+                if(ready())
+                    return;
+                cpu_relax();
+            }
+
+            for(unsigned i = 0; i != yields; ++i) {
+                if(ready())
+                    return;
+                std::this_thread::yield();
+            }
+
+            while(!ready())
+                std::this_thread::sleep_for(period);
+        }
+
+
+        template<futex_scope Scope, typename F>
+        void wait_until(basic_futex_event<Scope>&,
+                        F&& ready) const noexcept {
+            wait_until(ready);
+        }
+    };   // sleeping_wait
+
+
+    // Parks on the event, without event it can only yield
+    struct blocking_wait {
+        template<typename F>
+        void wait_until(F&& ready) const noexcept {
+            while(!ready())
+                std::this_thread::yield();
+        }
+
+
+        template<futex_scope Scope, typename F>
+        void wait_until(basic_futex_event<Scope>& event,
+                        F&& ready) const noexcept {
+            for(;;) {
+                // Notification after this point changes value,
+                // so the wait below doesn't miss it
+                auto const notified = event.value();
+                if(ready())
+                    return;
+                event.wait(notified);
+            }
+        }
+    };   // blocking_wait
+
+
+    // Spins, yields, then parks on the event or sleeps without it
+    struct adaptive_wait {
+        unsigned spins {1000};
+        unsigned yields {10};
+        std::chrono::nanoseconds period {std::chrono::microseconds {50}};
+
+        template<typename F>
+        void wait_until(F&& ready) const noexcept {
+            sleeping_wait {spins, yields, period}.wait_until(ready);
+        }
+
+
+        template<futex_scope Scope, typename F>
+        void wait_until(basic_futex_event<Scope>& event,
+                        F&& ready) const noexcept {
+            for(unsigned i = 0; i != spins; ++i) {
+                if(ready())
+                    return;
+                cpu_relax();
+            }
+
+            for(unsigned i = 0; i != yields; ++i) {
+                if(ready())
+                    return;
+                std::this_thread::yield();
+            }
+
+            blocking_wait {}.wait_until(event, ready);
+        }
+    };   // adaptive_wait
+
+
+}   // namespace hydra
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <hydra/activity.hpp>
+#include <hydra/wait_strategy.hpp>
+
+#include "histogram.hpp"
+
+
+// Open-loop load: messages are published on a fixed schedule whether
+// the activity keeps up or not, and latency is counted from the time
+// a message was scheduled to be sent. A producer stalled by a full
+// queue does not hide the delay its messages would have seen
+// (coordinated omission).
+
+
+namespace {
+
+
+    using clock = std::chrono::steady_clock;
+
+    constexpr std::uint32_t queue_capacity = 1 << 16;
+    // Knee is the highest rate the activity sustains without p99
+    // latency growing this many times over the lowest rate one
+    constexpr double knee_latency_growth = 10.;
+    constexpr double knee_rate_share = 0.95;
+
+
+    struct options {
+        std::chrono::milliseconds duration {1000};
+        std::chrono::nanoseconds work {0};
+        bench::output_format format {bench::output_format::text};
+        std::vector<double> rates;
+    };
+
+
+    struct outcome {
+        double target_rate;     // messages per second
+        double achieved_rate;   // messages per second handled
+        bench::latency_histogram latencies;
+    };
+
+
+    std::int64_t now_ns() noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   clock::now().time_since_epoch())
+            .count();
+    }
+
+
+    // Simulates handler cost
+    void spin_for(std::chrono::nanoseconds work) noexcept {
+        if(work.count() == 0)
+            return;
+        auto const until = now_ns() + work.count();
+        while(now_ns() < until)
+            hydra::cpu_relax();
+    }
+
+
+    outcome run_at(double rate, options const& opts) {
+        auto const count = std::int64_t(
+            rate * std::chrono::duration<double>(opts.duration).count());
+        auto const period = 1e9 / rate;
+
+        outcome result {rate, 0., {}};
+        std::atomic<std::int64_t> handled {0};
+        std::int64_t last_handled_at = 0;
+
+        // Messages are scheduled send times
+        hydra::activity<std::int64_t> activity;
+        activity.reserve(queue_capacity);
+        activity.run([&](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                spin_for(opts.work);
+                last_handled_at = now_ns();
+                result.latencies.record(last_handled_at - batch[n]);
+                batch.fetched();
+                handled.fetch_add(1, std::memory_order_release);
+            }
+        });
+
+        auto const started = now_ns();
+        for(std::int64_t i = 0; i != count; ++i) {
+            auto const scheduled = started + std::int64_t(double(i) * period);
+            while(now_ns() < scheduled)
+                hydra::cpu_relax();
+            auto const n = activity.claim();
+            activity[n] = scheduled;
+            activity.publish(n);
+        }
+
+        while(handled.load(std::memory_order_acquire) != count)
+            std::this_thread::yield();
+        activity.stop();
+
+        auto const elapsed = double(last_handled_at - started) / 1e9;
+        result.achieved_rate = elapsed > 0. ? double(count) / elapsed : 0.;
+        return result;
+    }
+
+
+    std::vector<double> default_rates() {
+        return {1e4, 3e4, 1e5, 3e5, 1e6, 2e6, 4e6, 8e6, 16e6};
+    }
+
+
+    bool parse(int argc, char** argv, options& opts) {
+        for(int i = 1; i != argc; ++i) {
+            char const* arg = argv[i];
+            if(std::strcmp(arg, "--csv") == 0)
+                opts.format = bench::output_format::csv;
+            else if(std::strcmp(arg, "--json") == 0)
+                opts.format = bench::output_format::json;
+            else if(std::strncmp(arg, "--duration=", 11) == 0)
+                opts.duration =
+                    std::chrono::milliseconds {std::atoll(arg + 11)};
+            else if(std::strncmp(arg, "--work=", 7) == 0)
+                opts.work = std::chrono::nanoseconds {std::atoll(arg + 7)};
+            else if(std::atof(arg) > 0.)
+                opts.rates.push_back(std::atof(arg));
+            else
+                return false;
+        }
+        if(opts.rates.empty())
+            opts.rates = default_rates();
+        return opts.duration.count() > 0;
+    }
+
+
+    // Highest rate before throughput falls behind or p99 takes off,
+    // zero when even the lowest one is not sustained
+    double saturation_knee(std::vector<outcome> const& outcomes) {
+        if(outcomes.empty())
+            return 0.;
+        auto const base_p99 = double(
+            (std::max)(outcomes.front().latencies.percentile(99.),
+                       std::int64_t(1)));
+        double knee = 0.;
+        for(auto const& o: outcomes) {
+            auto const p99 = double(o.latencies.percentile(99.));
+            if(o.achieved_rate < o.target_rate * knee_rate_share
+               || p99 > base_p99 * knee_latency_growth)
+                break;
+            knee = o.target_rate;
+        }
+        return knee;
+    }
+
+
+}   // namespace
+
+
+// Usage: hydra-loadgen [--duration=ms] [--work=ns] [--csv | --json]
+//                      [rate ...]
+// rates are messages per second, each one runs for the duration
+int main(int argc, char** argv) {
+    options opts;
+    if(!parse(argc, argv, opts)) {
+        std::fprintf(stderr,
+                     "Usage: hydra-loadgen [--duration=ms] [--work=ns] "
+                     "[--csv | --json] [rate ...]\n");
+        return -1;
+    }
+
+    std::vector<outcome> outcomes;
+    std::vector<bench::measurement> report;
+    for(auto const rate: opts.rates) {
+        outcomes.push_back(run_at(rate, opts));
+        auto m = bench::latency_measurement("open_loop",
+                                            std::to_string(
+                                                std::int64_t(rate)),
+                                            1,
+                                            sizeof(std::int64_t),
+                                            outcomes.back().latencies);
+        m.throughput = outcomes.back().achieved_rate / 1e6;
+        report.push_back(m);
+    }
+
+    bench::print(report, opts.format);
+    if(opts.format == bench::output_format::text)
+        std::printf("saturation knee: %.0f msg/s\n", saturation_knee(outcomes));
+    return 0;
+}
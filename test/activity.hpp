@@ -1,6 +1,7 @@
 #pragma once
 
 
+#include <atomic>
 #include <string>
 #include <thread>
 
@@ -52,6 +53,83 @@ TEST_CASE("activity::run/2") {
 }
 
 
+TEST_CASE("activity::publish_range") {
+    hydra::activity<int> target;
+    target.reserve(64);
+    std::atomic<int> sum {0};
+    target.run([&sum](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            sum += batch[n];
+            batch.fetched();
+        }
+    });
+
+    for(int i = 0; i != 10; ++i) {
+        auto const range = target.claim_n(10);
+        REQUIRE(range.size() == 10);
+        for(auto n: range)
+            target[n] = 1;
+        target.publish_range(range);
+    }
+
+    target.stop();
+    REQUIRE(sum == 100);
+}
+
+
+TEST_CASE("activity::run/4") {
+    hydra::activity<int> target;
+    target.reserve(16);
+    std::atomic<int> sum {0};
+    target.run([&sum](auto& batch) {
+        auto const messages = batch.fetch_available(batch.size());
+        for(auto n: messages.head)
+            sum += n;
+        for(auto n: messages.tail)
+            sum += n;
+        batch.fetched(messages.size());
+    });
+
+    for(int i = 1; i != 101; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+
+    target.stop();
+    REQUIRE(sum == 5050);
+}
+
+
+TEST_CASE_TEMPLATE("activity::wait_strategy", W,
+                   hydra::busy_spin_wait,
+                   hydra::yielding_wait,
+                   hydra::sleeping_wait,
+                   hydra::blocking_wait,
+                   hydra::adaptive_wait) {
+    hydra::activity<int, hydra::mpsc_queue<int>, W> target;
+    target.reserve(4);
+    std::atomic<int> sum {0};
+    target.run([&sum](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            sum += batch[n];
+            batch.fetched();
+        }
+    });
+
+    for(int i = 1; i != 101; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+
+    while(sum != 5050)
+        std::this_thread::yield();
+    target.stop();
+    REQUIRE(!target.active());
+}
+
+
 TEST_CASE("activity::run/3") {
     hydra::activity<std::string> target;
 
@@ -72,4 +150,29 @@ TEST_CASE("activity::run/3") {
 }
 
 
+TEST_CASE("activity::resize") {
+    hydra::activity<int> target;
+    target.reserve(2);
+    std::atomic<int> sum {0};
+    target.run([&sum](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            sum += batch[n];
+            batch.fetched();
+        }
+    });
+
+    for(int i = 1; i != 1001; ++i) {
+        if(i == 500)
+            target.resize(256);
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+
+    target.stop();
+    REQUIRE(sum == 500500);
+    REQUIRE(target.resizes_count() == 1);
+}
+
+
 }
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "doctest.h"
+
+#include <hydra/activity_pool.hpp>
+
+
+TEST_SUITE("activity_pool") {
+
+
+TEST_CASE("activity_pool::activity_pool") {
+    hydra::activity_pool<int> target;
+    REQUIRE(!target.active());
+    REQUIRE(target.workers_count() == 0);
+}
+
+
+TEST_CASE("activity_pool::run") {
+    hydra::activity_pool<int> target;
+    bool const started_without_buffer = target.run([](auto&) {}, 2);
+    REQUIRE(!started_without_buffer);
+    target.reserve(16);
+    bool const started_with_buffer = target.run([](auto&) {}, 2);
+    REQUIRE(started_with_buffer);
+    REQUIRE(target.workers_count() == 2);
+    bool const started_already_active = target.run([](auto&) {}, 2);
+    REQUIRE(!started_already_active);
+    target.stop();
+    REQUIRE(!target.active());
+}
+
+
+TEST_CASE("activity_pool::stop") {
+    hydra::activity_pool<int> target;
+    target.reserve(8);
+    std::atomic<int> sum {0};
+    std::mutex guard;
+    std::set<std::thread::id> workers;
+    target.run(
+        [&](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                sum += batch[n];
+                batch.fetched();
+            }
+            auto const lock = std::lock_guard {guard};
+            workers.insert(std::this_thread::get_id());
+        },
+        4);
+
+    for(int i = 1; i != 1001; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+
+    target.stop();
+    REQUIRE(sum == 500500);
+    REQUIRE(target.messages_processed() == 1000);
+    REQUIRE(!workers.empty());
+}
+
+
+TEST_CASE("activity_pool::publish_range") {
+    hydra::activity_pool<int> target;
+    target.reserve(64);
+    std::atomic<int> sum {0};
+    target.run(
+        [&sum](auto& batch) {
+            auto const messages = batch.fetch_available(8);
+            for(std::size_t i = 0; i != messages.size(); ++i)
+                sum += messages[i];
+            batch.fetched(std::int64_t(messages.size()));
+        },
+        3);
+
+    for(int i = 0; i != 50; ++i) {
+        auto const range = target.claim_n(20);
+        for(auto n: range)
+            target[n] = 1;
+        target.publish_range(range);
+    }
+
+    target.stop();
+    REQUIRE(sum == 1000);
+}
+
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+
+#include <hydra/batch.hpp>
+#include <hydra/broadcast_queue.hpp>
+
+
+TEST_SUITE("broadcast_queue") {
+
+
+TEST_CASE("broadcast_queue::broadcast_queue") {
+    hydra::broadcast_queue<int> target;
+    REQUIRE(!target);
+    REQUIRE(target.capacity() == 0);
+    REQUIRE(target.consumers_count() == 0);
+}
+
+
+TEST_CASE("broadcast_queue::subscribe") {
+    hydra::broadcast_queue<int> target {4};
+    auto& first = target.subscribe();
+    auto& second = target.subscribe();
+    REQUIRE(target.consumers_count() == 2);
+
+    auto const n = target.claim();
+    target[n] = 42;
+    REQUIRE(!first.try_fetch());
+    target.publish(n);
+
+    REQUIRE(first.try_fetch() == n);
+    REQUIRE(second.try_fetch() == n);
+    REQUIRE(first[n] == 42);
+    first.fetched();
+    REQUIRE(!first.try_fetch());
+    REQUIRE(second.ready());
+    REQUIRE(second.size() == 1);
+}
+
+
+TEST_CASE("broadcast_queue::slowest_consumer") {
+    hydra::broadcast_queue<int> target {2};
+    auto& fast = target.subscribe();
+    auto& slow = target.subscribe();
+
+    auto const range = target.claim_n(2);
+    target.publish_range(range);
+    fast.fetched(fast.fetch_available(2).size());
+    REQUIRE(!fast.ready());
+
+    auto const blocked = target.claim_for(std::chrono::microseconds {1});
+    REQUIRE(!blocked);
+
+    auto const messages = slow.fetch_available(4);
+    REQUIRE(messages.size() == 2);
+    slow.fetched(messages.size());
+    auto const claimed = target.claim_for(std::chrono::microseconds {1});
+    REQUIRE(!!claimed);
+    // Timed out claim took no sequence, consumers are not stalled
+    REQUIRE(claimed.value() == 2);
+    target[claimed] = 3;
+    target.publish(claimed);
+    REQUIRE(fast.ready());
+    REQUIRE(fast.fetch_available(4).size() == 1);
+}
+
+
+TEST_CASE("broadcast_queue::multithreading") {
+    constexpr std::uint64_t total = 100000;
+    hydra::broadcast_queue<std::uint64_t> target {64};
+    std::vector<hydra::broadcast_queue<std::uint64_t>::consumer*> consumers;
+    for(int i = 0; i != 3; ++i)
+        consumers.push_back(&target.subscribe());
+
+    std::vector<std::uint64_t> sums(consumers.size());
+    std::vector<std::thread> threads;
+    for(std::size_t i = 0; i != consumers.size(); ++i)
+        threads.emplace_back([&sums, &consumers, i] {
+            auto& cursor = *consumers[i];
+            std::uint64_t received = 0;
+            while(received != total) {
+                auto messages = hydra::batch {cursor};
+                for(auto n = messages.try_fetch(); !!n;
+                    n = messages.try_fetch()) {
+                    sums[i] += messages[n];
+                    messages.fetched();
+                    ++received;
+                }
+            }
+        });
+
+    for(std::uint64_t i = 1; i <= total; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+
+    for(auto& thread: threads)
+        thread.join();
+
+    for(auto const sum: sums)
+        REQUIRE(sum == total * (total + 1) / 2);
+}
+
+
+}
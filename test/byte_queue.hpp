@@ -0,0 +1,147 @@
+#pragma once
+
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+
+#include <hydra/byte_queue.hpp>
+
+
+namespace {
+
+
+    std::string_view as_text(std::span<std::byte const> bytes) {
+        return std::string_view {reinterpret_cast<char const*>(bytes.data()),
+                                 bytes.size()};
+    }
+
+
+    bool push_text(hydra::byte_queue<>& queue, std::string_view text) {
+        auto const claimed = queue.claim(std::int64_t(text.size()));
+        if(!claimed)
+            return false;
+        std::memcpy(claimed.bytes.data(), text.data(), text.size());
+        queue.publish(claimed);
+        return true;
+    }
+
+
+}   // namespace
+
+
+TEST_SUITE("byte_queue") {
+
+
+TEST_CASE("byte_queue::byte_queue") {
+    hydra::byte_queue<> target;
+    REQUIRE(!target);
+    REQUIRE(!target.claim(1));
+    REQUIRE(!target.try_fetch());
+}
+
+
+TEST_CASE("byte_queue::claim") {
+    hydra::byte_queue<> target {64};
+    REQUIRE(target.capacity() == 64);
+    REQUIRE(target.max_record_size() == 24);
+    REQUIRE(!target.claim(25));
+
+    auto const claimed = target.claim(5);
+    REQUIRE(!!claimed);
+    REQUIRE(claimed.bytes.size() == 5);
+    REQUIRE(!target.try_fetch());
+    target.publish(claimed);
+    REQUIRE(target.size() == 16);
+
+    auto const n = target.try_fetch();
+    REQUIRE(n == claimed.position);
+    REQUIRE(target[n].size() == 5);
+    target.fetched();
+    REQUIRE(!target.try_fetch());
+    REQUIRE(target.size() == 0);
+
+    auto const empty = target.claim(0);
+    target.publish(empty);
+    REQUIRE(target[target.try_fetch()].empty());
+}
+
+
+TEST_CASE("byte_queue::wraparound") {
+    hydra::byte_queue<> target {128};
+    for(int i = 0; i != 100; ++i) {
+        auto const text =
+            std::string(std::size_t(1 + i % 30), char('a' + i % 26));
+        REQUIRE(push_text(target, text));
+        auto const n = target.try_fetch();
+        REQUIRE(!!n);
+        REQUIRE(as_text(target[n]) == text);
+        target.fetched();
+        REQUIRE(target.size() == 0);
+    }
+}
+
+
+TEST_CASE("byte_queue::max record at nonzero index") {
+    hydra::byte_queue<> target {64};
+    REQUIRE(push_text(target, "1"));
+    target.try_fetch();
+    target.fetched();
+    for(int i = 0; i != 8; ++i) {
+        auto const text = std::string(
+            std::size_t(target.max_record_size()), char('a' + i));
+        REQUIRE(push_text(target, text));
+        auto const n = target.try_fetch();
+        REQUIRE(!!n);
+        REQUIRE(as_text(target[n]) == text);
+        target.fetched();
+        REQUIRE(target.size() == 0);
+    }
+}
+
+
+TEST_CASE("byte_queue::claim_for") {
+    hydra::byte_queue<> target {32};
+    REQUIRE(!!target.claim_for(8, std::chrono::microseconds {1}));
+    REQUIRE(!!target.claim_for(8, std::chrono::microseconds {1}));
+    REQUIRE(!target.claim_for(8, std::chrono::microseconds {1}));
+}
+
+
+TEST_CASE("byte_queue::multithreading") {
+    hydra::byte_queue<> target {256};
+    constexpr int producers_count = 4;
+    constexpr int numbers_count = 10000;
+
+    std::vector<std::thread> producers;
+    for(int i = 0; i != producers_count; ++i)
+        producers.emplace_back([&target] {
+            for(int n = 1; n <= numbers_count; ++n)
+                push_text(target, std::to_string(n));
+        });
+
+    std::int64_t sum = 0;
+    for(int received = 0; received != producers_count * numbers_count;) {
+        auto const n = target.try_fetch();
+        if(!n)
+            continue;
+        sum += std::stoll(std::string {as_text(target[n])});
+        target.fetched();
+        ++received;
+    }
+
+    for(auto& producer: producers)
+        producer.join();
+
+    REQUIRE(sum == std::int64_t(producers_count) * numbers_count
+                       * (numbers_count + 1) / 2);
+}
+
+
+}
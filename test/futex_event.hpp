@@ -1,13 +1,79 @@
 #pragma once
 
 
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <vector>
+
 #include "doctest.h"
 
 #include <hydra/futex_event.hpp>
 
 TEST_SUITE("futex_event.hpp") {
 	
+	TEST_CASE("futex_event::notify_one") {
+		hydra::futex_event target;
+
+		REQUIRE(target.value() == 0);
+		REQUIRE(target.waiters() == 0);
+
+		target.notify_one();
+
+		REQUIRE(target.value() == 1);
+		REQUIRE(target.syscalls_count() == 0);
+	}
+
+
 	TEST_CASE("futex_event::wait") {
-		
+		hydra::futex_event target;
+
+		auto const notified = target.value();
+		target.notify_one();
+		target.wait(notified);
+
+		REQUIRE(target.value() == notified + 1);
+		REQUIRE(target.waiters() == 0);
+	}
+
+
+	TEST_CASE("futex_event::stress") {
+		using namespace std::chrono;
+		constexpr auto consumers_count = 4;
+		constexpr auto events_count = 100000;
+		constexpr auto timeout = seconds {1};
+		hydra::futex_event target;
+		std::atomic<int> produced {0};
+
+		std::vector<std::future<int>> consumers;
+		for(auto i = 0; i != consumers_count; ++i)
+			consumers.push_back(std::async(std::launch::async, [&] {
+				auto lost_wakeups = 0, seen = 0;
+				while(seen != events_count) {
+					auto const notified = target.value();
+					auto const current = produced.load(std::memory_order_acquire);
+					if(current != seen) {
+						seen = current;
+						continue;
+					}
+					auto const started = steady_clock::now();
+					target.wait(notified, timeout);
+					if(steady_clock::now() - started >= timeout)
+						++lost_wakeups;
+				}
+				return lost_wakeups;
+			}));
+
+		for(auto i = 0; i != events_count; ++i) {
+			produced.fetch_add(1, std::memory_order_release);
+			target.notify_one();
+			target.notify_one();
+			target.notify_one();
+			target.notify_one();
+		}
+
+		for(auto& consumer: consumers)
+			REQUIRE(consumer.get() == 0);
+		REQUIRE(target.waiters() == 0);
 	}
 }
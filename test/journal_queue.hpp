@@ -0,0 +1,333 @@
+#pragma once
+
+
+#if defined(__linux__)
+
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <thread>
+
+#include <unistd.h>
+
+#include "doctest.h"
+
+#include <hydra/activity.hpp>
+#include <hydra/journal_queue.hpp>
+
+
+namespace {
+
+
+    // Removed with its files when the test is over
+    struct journal_directory {
+        std::filesystem::path path;
+
+        explicit journal_directory(char const* name)
+            : path {std::filesystem::temp_directory_path()
+                    / ("hydra-" + std::to_string(getpid()) + "-" + name)} {
+            std::filesystem::remove_all(path);
+        }
+
+        ~journal_directory() { std::filesystem::remove_all(path); }
+
+        hydra::journal_options options(std::size_t max_files = 16) const {
+            return hydra::journal_options {path, 4, max_files};
+        }
+
+
+        std::size_t files_count() const {
+            std::size_t count = 0;
+            for(auto const& each: std::filesystem::directory_iterator {path})
+                count += each.path().extension() == ".journal" ? 1 : 0;
+            return count;
+        }
+    };   // journal_directory
+
+
+    void write_journal(hydra::journal_queue<std::int64_t>& journal,
+                       std::int64_t count) {
+        for(std::int64_t i = 0; i != count; ++i) {
+            auto const n = journal.claim();
+            journal[n] = n.value() * 10;
+            journal.publish(n);
+        }
+    }
+
+
+}   // namespace
+
+
+TEST_SUITE("journal_queue") {
+
+
+TEST_CASE("journal_queue::rolling files") {
+    journal_directory directory {"rolling"};
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(!target);
+    REQUIRE(target.open(directory.options()));
+    REQUIRE(target.file_messages() == 4);
+
+    write_journal(target, 10);
+    REQUIRE(target.size() == 10);
+    for(std::int64_t i = 0; i != 10; ++i) {
+        auto const n = target.try_fetch();
+        REQUIRE(n.value() == i);
+        REQUIRE(target[n] == i * 10);
+        target.fetched();
+    }
+    REQUIRE(!target.try_fetch());
+
+    REQUIRE(target.durable().value() == 0);
+    REQUIRE(target.sync() == 10);
+    REQUIRE(target.durable().value() == 10);
+    REQUIRE(target.sync() == 0);
+
+    REQUIRE(directory.files_count() == 3);
+}
+
+
+TEST_CASE("journal_queue::retire") {
+    journal_directory directory {"retire"};
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(target.open(directory.options(2)));
+
+    write_journal(target, 8);
+    REQUIRE(!target.try_claim());
+    REQUIRE(target.size() == 8);
+
+    // Neither fetched nor durable records are retired
+    REQUIRE(target.retire(hydra::sequence {8}).value() == 0);
+    for(auto i = 0; i != 6; ++i) {
+        target.try_fetch();
+        target.fetched();
+    }
+    REQUIRE(target.retire(hydra::sequence {8}).value() == 0);
+    target.sync();
+    REQUIRE(target.retire(hydra::sequence {8}).value() == 4);
+    REQUIRE(target.first().value() == 4);
+    REQUIRE(directory.files_count() == 1);
+
+    // Producer waits for room until the consumer retires a file
+    auto producer = std::thread {[&target] { write_journal(target, 8); }};
+    for(auto i = 0; i != 2; ++i) {
+        while(!target.try_fetch())
+            std::this_thread::yield();
+        target.fetched();
+    }
+    target.sync();
+    REQUIRE(target.retire(hydra::sequence {8}).value() == 8);
+    producer.join();
+    REQUIRE(target.size() == 8);
+    for(std::int64_t i = 8; i != 16; ++i) {
+        auto const n = target.try_fetch();
+        REQUIRE(n.value() == i);
+        REQUIRE(target[n] == i * 10);
+        target.fetched();
+    }
+    REQUIRE(directory.files_count() == 2);
+}
+
+
+TEST_CASE("journal_queue::reopen after retire") {
+    journal_directory directory {"reopen"};
+    {
+        hydra::journal_queue<std::int64_t> target;
+        REQUIRE(target.open(directory.options()));
+        write_journal(target, 10);
+        for(auto i = 0; i != 10; ++i) {
+            target.try_fetch();
+            target.fetched();
+        }
+        target.sync();
+        target.retire(hydra::sequence {10});
+    }
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(target.open(directory.options()));
+    REQUIRE(target.first().value() == 8);
+    auto reader = target.replay(hydra::sequence {0});
+    REQUIRE(reader.try_fetch().value() == 8);
+    REQUIRE(target.claim().value() == 10);
+}
+
+
+TEST_CASE("journal_queue::replay after restart") {
+    journal_directory directory {"restart"};
+    {
+        hydra::journal_queue<std::int64_t> target;
+        REQUIRE(target.open(directory.options()));
+        write_journal(target, 10);
+        target.sync();
+    }
+
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(target.open(directory.options()));
+    REQUIRE(target.first().value() == 0);
+    REQUIRE(target.size() == 0);
+
+    auto reader = target.replay(hydra::sequence {3});
+    for(std::int64_t i = 3; i != 10; ++i) {
+        auto const n = reader.try_fetch();
+        REQUIRE(n.value() == i);
+        REQUIRE(reader[n] == i * 10);
+        reader.fetched();
+    }
+    REQUIRE(!reader.try_fetch());
+
+    auto const n = target.claim();
+    REQUIRE(n.value() == 10);
+    target[n] = 100;
+    target.publish(n);
+    REQUIRE(reader.try_fetch().value() == 10);
+}
+
+
+TEST_CASE("journal_queue::unpublished records are dropped") {
+    journal_directory directory {"hole"};
+    {
+        hydra::journal_queue<std::int64_t> target;
+        REQUIRE(target.open(directory.options()));
+        auto const first = target.claim();
+        auto const second = target.claim();
+        auto const third = target.claim();
+        target.publish(first);
+        target.publish(third);
+        (void)second;
+    }
+
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(target.open(directory.options()));
+    auto reader = target.replay(hydra::sequence {0});
+    REQUIRE(reader.try_fetch().value() == 0);
+    reader.fetched();
+    REQUIRE(!reader.try_fetch());
+    REQUIRE(target.claim().value() == 1);
+}
+
+
+TEST_CASE("journal_queue::mismatched files") {
+    journal_directory directory {"mismatch"};
+    {
+        hydra::journal_queue<std::int64_t> target;
+        REQUIRE(target.open(directory.options()));
+        write_journal(target, 1);
+    }
+    hydra::journal_queue<std::int32_t> target;
+    REQUIRE(!target.open(directory.options()));
+}
+
+
+TEST_CASE("journal_queue::truncated file") {
+    journal_directory directory {"truncated"};
+    {
+        hydra::journal_queue<std::int64_t> target;
+        REQUIRE(target.open(directory.options()));
+        write_journal(target, 1);
+    }
+    auto const file = directory.path / "00000000000000000000.journal";
+    std::filesystem::resize_file(file, 100);
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(!target.open(directory.options()));
+}
+
+
+TEST_CASE("journal_queue::missing file") {
+    journal_directory directory {"gap"};
+    {
+        hydra::journal_queue<std::int64_t> target;
+        REQUIRE(target.open(directory.options()));
+        write_journal(target, 12);
+    }
+    std::filesystem::remove(directory.path / "00000000000000000004.journal");
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(!target.open(directory.options()));
+}
+
+
+TEST_CASE("journal_queue::syncing") {
+    journal_directory directory {"syncing"};
+    hydra::journal_queue<std::int64_t> target;
+    REQUIRE(target.open(directory.options()));
+    REQUIRE(target.start_syncing());
+    REQUIRE(!target.start_syncing());
+    write_journal(target, 50);
+    target.stop_syncing();
+    REQUIRE(target.durable().value() == 50);
+
+    REQUIRE(target.start_syncing(std::chrono::milliseconds {1}));
+    write_journal(target, 10);
+    target.stop_syncing();
+    REQUIRE(target.durable().value() == 60);
+}
+
+
+TEST_CASE("journal_queue::durable delivery") {
+    journal_directory directory {"durable"};
+    using journal = hydra::journal_queue<std::int64_t>;
+    hydra::activity<std::int64_t, journal> target;
+    auto options = directory.options();
+    options.durable_delivery = true;
+    REQUIRE(target.open(options));
+    std::atomic<int> not_durable {0};
+    std::atomic<int> handled {0};
+    journal const& queue = target.queue();
+    target.run([&](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            if(queue.durable().value() <= n.value())
+                ++not_durable;
+            batch.fetched();
+            ++handled;
+        }
+    });
+    for(std::int64_t i = 0; i != 40; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+    target.stop();
+    REQUIRE(handled == 40);
+    REQUIRE(not_durable == 0);
+    REQUIRE(target.queue().durable().value() == 40);
+}
+
+
+TEST_CASE("journal_queue::activity") {
+    journal_directory directory {"activity"};
+    std::atomic<std::int64_t> sum {0};
+    {
+        hydra::activity<std::int64_t, hydra::journal_queue<std::int64_t>>
+            target;
+        REQUIRE(target.open(directory.options()));
+        target.run([&sum](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                sum += batch[n];
+                batch.fetched();
+            }
+        });
+        for(std::int64_t i = 0; i != 40; ++i) {
+            auto const n = target.claim();
+            target[n] = i;
+            target.publish(n);
+        }
+        target.stop();
+    }
+    REQUIRE(sum == 780);
+
+    hydra::journal_queue<std::int64_t> journal;
+    REQUIRE(journal.open(directory.options()));
+    auto reader = journal.replay(journal.first());
+    std::int64_t replayed = 0;
+    for(auto n = reader.try_fetch(); !!n; n = reader.try_fetch()) {
+        replayed += reader[n];
+        reader.fetched();
+    }
+    REQUIRE(replayed == 780);
+}
+
+
+}
+
+
+#endif
@@ -0,0 +1,105 @@
+#pragma once
+
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+
+#include <hydra/activity.hpp>
+#include <hydra/metrics.hpp>
+
+
+TEST_SUITE("metrics") {
+
+
+TEST_CASE("metrics::snapshot") {
+    hydra::metrics target;
+    auto const empty = target.snapshot();
+    REQUIRE(empty.published == 0);
+    REQUIRE(empty.mean_batch() == 0.);
+
+    target.published(3, true);
+    target.published(1, false);
+    target.batch_done(4, 3, std::chrono::nanoseconds {10});
+    target.batch_done(1, 1, std::chrono::nanoseconds {5});
+
+    auto const s = target.snapshot();
+    REQUIRE(s.published == 4);
+    REQUIRE(s.wakeups == 1);
+    REQUIRE(s.processed == 4);
+    REQUIRE(s.batches == 2);
+    REQUIRE(s.max_batch == 3);
+    REQUIRE(s.depth_high_water == 4);
+    REQUIRE(s.busy_time == std::chrono::nanoseconds {15});
+    REQUIRE(s.mean_batch() == 2.);
+}
+
+
+TEST_CASE("metrics::shards") {
+    constexpr auto threads_count = 2 * hydra::metrics::shards_count + 1;
+    constexpr auto adds_count = 10000;
+    hydra::metrics target;
+    std::atomic<bool> done {false};
+
+    // Scraping while producers count must not lose their increments
+    auto scraper = std::thread {[&target, &done] {
+        std::uint64_t last = 0;
+        while(!done.load(std::memory_order_acquire)) {
+            auto const published = target.snapshot().published;
+            REQUIRE(published >= last);
+            last = published;
+        }
+    }};
+
+    std::vector<std::thread> producers;
+    for(std::size_t i = 0; i != threads_count; ++i)
+        producers.emplace_back([&target] {
+            for(auto j = 0; j != adds_count; ++j)
+                target.published(1, true);
+        });
+    for(auto& producer: producers)
+        producer.join();
+    done.store(true, std::memory_order_release);
+    scraper.join();
+
+    auto const s = target.snapshot();
+    REQUIRE(s.published == threads_count * adds_count);
+    REQUIRE(s.wakeups == threads_count * adds_count);
+}
+
+
+TEST_CASE("activity::snapshot") {
+    constexpr auto messages_count = 1000;
+    hydra::activity<int> target;
+    target.reserve(64);
+    std::atomic<int> processed {0};
+    target.run([&processed](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            batch.fetched();
+            processed.fetch_add(1, std::memory_order_relaxed);
+        }
+    });
+
+    for(auto i = 0; i != messages_count; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+    target.stop();
+
+    auto const s = target.snapshot();
+    REQUIRE(s.published == messages_count);
+    REQUIRE(s.processed == messages_count);
+    REQUIRE(s.batches != 0);
+    REQUIRE(s.max_batch <= 64);
+    // Producer waiting for room has claimed its sequence already
+    REQUIRE(s.depth_high_water <= 64 + 1);
+    REQUIRE(s.mean_batch() >= 1.);
+    REQUIRE(s.wakeups >= messages_count);
+    REQUIRE(s.wake_syscalls <= s.wakeups);
+}
+
+
+}
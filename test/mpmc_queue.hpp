@@ -0,0 +1,201 @@
+#pragma once
+
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+
+#include <hydra/activity.hpp>
+#include <hydra/mpmc_queue.hpp>
+
+
+TEST_SUITE("mpmc_queue") {
+
+
+	TEST_CASE("mpmc_queue::mpmc_queue()") {
+		hydra::mpmc_queue<int> target;
+
+		REQUIRE(target.capacity() == 0);
+		REQUIRE(!target);
+		REQUIRE(target.size() == 0);
+	}
+
+
+	TEST_CASE("mpmc_queue::claim") {
+		hydra::mpmc_queue<int> target(1);
+		auto const c1 = target.claim();
+
+		REQUIRE(!!c1);
+		REQUIRE(c1.value() == 0);
+
+		auto const c2 = target.claim();
+
+		REQUIRE(c2.value() == 1);
+		REQUIRE(target.size() == 2);
+
+		auto const c3 = target.claim_for(std::chrono::microseconds {1});
+		REQUIRE(!c3);
+		REQUIRE(target.size() == 2);
+	}
+
+
+	TEST_CASE("mpmc_queue::claim_for timeout") {
+		hydra::mpmc_queue<int> target(2);
+		auto const c1 = target.claim();
+		auto const c2 = target.claim();
+		REQUIRE(!target.claim_for(std::chrono::microseconds {1}));
+
+		target.publish(c1);
+		target.publish(c2);
+		for(auto i = 0; i != 2; ++i) {
+			auto const n = target.try_fetch();
+			REQUIRE(!!n);
+			target.fetched(n);
+		}
+
+		// Timed out claim left no gap, consumers go on
+		auto const c3 = target.claim_for(std::chrono::microseconds {1});
+		REQUIRE(c3.value() == 2);
+		target[c3] = 3;
+		target.publish(c3);
+		auto const n = target.try_fetch();
+		REQUIRE(n.value() == 2);
+		REQUIRE(target[n] == 3);
+		target.fetched(n);
+	}
+
+
+	TEST_CASE("mpmc_queue::try_fetch") {
+		hydra::mpmc_queue<int> target(2);
+
+		REQUIRE(!target.try_fetch());
+
+		auto const p1 = target.claim();
+		auto const p2 = target.claim();
+		target[p1] = -1;
+		target[p2] = -2;
+
+		REQUIRE(!target.ready());
+		REQUIRE(!target.try_fetch());
+
+		target.publish(p2);
+		REQUIRE(!target.try_fetch());
+
+		target.publish(p1);
+		REQUIRE(target.ready());
+
+		auto const f1 = target.try_fetch();
+		auto const f2 = target.try_fetch();
+		REQUIRE(f1 == p1);
+		REQUIRE(f2 == p2);
+		REQUIRE(!target.try_fetch());
+
+		target.fetched(f2);
+		target.fetched(f1);
+
+		auto const p3 = target.claim_for(std::chrono::microseconds {1});
+		REQUIRE(!!p3);
+		REQUIRE(p3.value() == 2);
+	}
+
+
+	TEST_CASE("mpmc_queue::fetch_available") {
+		hydra::mpmc_queue<int> target(4);
+
+		auto const r1 = target.claim_n(3);
+		for(auto n: r1)
+			target[n] = int(n.value());
+		target.publish_range(r1);
+
+		auto const f1 = target.fetch_available(8);
+		REQUIRE(f1.size() == 3);
+		REQUIRE(f1.first.value() == 0);
+		target.fetched(f1.first, 3);
+
+		auto const r2 = target.claim_n(4);
+		for(auto n: r2)
+			target[n] = int(n.value());
+		target.publish_range(r2);
+
+		auto const f2 = target.fetch_available(8);
+		REQUIRE(f2.head.size() == 1);
+		REQUIRE(f2.tail.size() == 3);
+		for(auto i = 0; i != 4; ++i)
+			REQUIRE(f2[i] == i + 3);
+		target.fetched(f2.first, 4);
+		REQUIRE(target.size() == 0);
+	}
+
+
+	TEST_CASE("mpmc_queue::multithreading") {
+		hydra::mpmc_queue<int> target(8);
+		constexpr auto producers_count = 4;
+		constexpr auto consumers_count = 3;
+		constexpr auto numbers_count = 1000;
+		constexpr auto total = producers_count * numbers_count;
+		std::atomic<int> consumed {0};
+
+		std::vector<std::future<int>> consumers;
+		for(auto i = 0; i != consumers_count; ++i)
+			consumers.push_back(std::async(std::launch::async, [&] {
+				auto sum = 0;
+				while(consumed.load() != total) {
+					auto const p = target.try_fetch();
+					if(!p) {
+						std::this_thread::yield();
+						continue;
+					}
+					sum += target[p];
+					target.fetched(p);
+					consumed.fetch_add(1);
+				}
+				return sum;
+			}));
+
+		std::vector<std::future<void>> producers;
+		for(auto i = 0; i != producers_count; ++i)
+			producers.push_back(std::async(std::launch::async, [&] {
+				for(auto n = 1; n != numbers_count + 1; ++n) {
+					auto const p = target.claim();
+					target[p] = n;
+					target.publish(p);
+				}
+			}));
+
+		for(auto& producer: producers)
+			producer.get();
+
+		auto sum = 0;
+		for(auto& consumer: consumers)
+			sum += consumer.get();
+
+		REQUIRE(sum == producers_count * (1 + numbers_count) * numbers_count / 2);
+	}
+
+
+	TEST_CASE("mpmc_queue::activity") {
+		hydra::activity<int, hydra::mpmc_queue<int>> target;
+		target.reserve(4);
+		std::atomic<int> sum {0};
+		target.run([&sum](auto& batch) {
+			for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+				sum += batch[n];
+				batch.fetched();
+			}
+		});
+
+		for(auto i = 1; i != 101; ++i) {
+			auto const n = target.claim();
+			target[n] = i;
+			target.publish(n);
+		}
+
+		target.stop();
+		REQUIRE(sum == 5050);
+	}
+
+
+}
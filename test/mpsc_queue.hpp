@@ -4,6 +4,7 @@
 
 #include <future>
 #include <thread>
+#include <vector>
 
 #include "doctest.h"
 
@@ -74,6 +75,48 @@ TEST_SUITE("mpsc_queue") {
 	}
 
 
+	TEST_CASE("mpsc_queue::claim_n") {
+		hydra::mpsc_queue<int> target(4);
+		auto const r1 = target.claim_n(3);
+
+		REQUIRE(!!r1);
+		REQUIRE(r1.first().value() == 0);
+		REQUIRE(r1.last().value() == 3);
+		REQUIRE(r1.size() == 3);
+		REQUIRE(target.size() == 3);
+
+		auto const r2 = target.claim_n(5);
+		REQUIRE(!r2);
+		REQUIRE(target.size() == 3);
+	}
+
+
+	TEST_CASE("mpsc_queue::publish_range") {
+		hydra::mpsc_queue<int> target(4);
+		auto const r1 = target.claim_n(3);
+		for(auto n: r1)
+			target[n] = int(n.value());
+		target.publish(target.claim());
+
+		auto const f1 = target.try_fetch();
+		REQUIRE(!f1);
+
+		target.publish_range(r1);
+
+		for(auto i = 0; i != 4; ++i) {
+			auto const f = target.try_fetch();
+			REQUIRE(!!f);
+			REQUIRE(f.value() == i);
+			target.fetched();
+		}
+
+		auto const r2 = target.claim_n(3);
+		REQUIRE(r2.first().value() == 4);
+		target.publish_range(r2.first(), r2.last());
+		REQUIRE(target.try_fetch().value() == 4);
+	}
+
+
 	TEST_CASE("mpsc_queue::operator []") {
 		hydra::mpsc_queue<int> target(1);
 		auto const c1 = target.claim();
@@ -114,6 +157,82 @@ TEST_SUITE("mpsc_queue") {
 	}
 
 
+	TEST_CASE("mpsc_queue::fetch_available") {
+		hydra::mpsc_queue<int> target(4);
+
+		auto const f1 = target.fetch_available(4);
+		REQUIRE(f1.empty());
+
+		for(auto i = 0; i != 3; ++i) {
+			auto const p = target.claim();
+			target[p] = i;
+			target.publish(p);
+		}
+		auto const f2 = target.fetch_available(2);
+		REQUIRE(f2.size() == 2);
+		REQUIRE(f2.tail.empty());
+		REQUIRE(f2[0] == 0);
+		REQUIRE(f2[1] == 1);
+		target.fetched(2);
+
+		auto const r1 = target.claim_n(3);
+		for(auto n: r1)
+			target[n] = int(n.value());
+		target.publish_range(r1);
+
+		auto const f3 = target.fetch_available(8);
+		REQUIRE(f3.size() == 4);
+		REQUIRE(f3.head.size() == 2);
+		REQUIRE(f3.tail.size() == 2);
+		for(auto i = 0; i != 4; ++i)
+			REQUIRE(f3[i] == i + 2);
+		target.fetched(4);
+		REQUIRE(target.size() == 0);
+	}
+
+
+	TEST_CASE("mpsc_queue::park_producers") {
+		hydra::mpsc_queue<int> target(4);
+		target.park_producers(2);
+		constexpr auto producers_count = 4;
+		constexpr auto numbers_count = 1000;
+
+		auto summator = std::async(std::launch::async, [&] {
+			auto count = 0, sum = 0;
+			while(count != producers_count * numbers_count) {
+				auto const p = target.try_fetch();
+				if(!p) {
+					std::this_thread::yield();
+					continue;
+				}
+				sum += target[p];
+				target.fetched();
+				++count;
+			}
+			return sum;
+		});
+
+		std::vector<std::future<void>> producers;
+		for(auto i = 0; i != producers_count; ++i)
+			producers.push_back(std::async(std::launch::async, [&] {
+				for(auto n = 1; n != numbers_count + 1; ++n) {
+					// Default yielding_wait parks as well
+					auto const p = target.claim();
+					target[p] = n;
+					target.publish(p);
+				}
+			}));
+
+		for(auto& producer: producers)
+			producer.get();
+
+		REQUIRE(summator.get()
+				== producers_count * (1 + numbers_count) * numbers_count / 2);
+		REQUIRE((target.blocks_count() == 0
+				 || target.blocked_time().count() > 0));
+	}
+
+
 	TEST_CASE("mpsc_queue::multithreading") {
 		hydra::mpsc_queue<int> target(1);
 		constexpr auto from_number = 1;
@@ -145,4 +264,117 @@ TEST_SUITE("mpsc_queue") {
 	}
 
 
+	TEST_CASE("mpsc_queue::resize") {
+		hydra::mpsc_queue<int> target(2);
+		REQUIRE(!target.resize(2));
+
+		auto const p1 = target.claim();
+		auto const p2 = target.claim();
+		target[p1] = 1;
+		target[p2] = 2;
+		target.publish(p1);
+		target.publish(p2);
+
+		REQUIRE(target.resize(8));
+		REQUIRE(target.capacity() == 8);
+		REQUIRE(target.resizes_count() == 1);
+		REQUIRE(target.size() == 2);
+
+		auto const range = target.claim_n(6);
+		REQUIRE(!!range);
+		for(auto n: range)
+			target[n] = 3;
+		target.publish_range(range);
+
+		REQUIRE(!target.resize(4));
+		REQUIRE(target.capacity() == 8);
+
+		auto const messages = target.fetch_available(8);
+		REQUIRE(messages.size() == 8);
+		REQUIRE(messages[0] == 1);
+		REQUIRE(messages[1] == 2);
+		target.fetched(std::int64_t(messages.size()));
+
+		REQUIRE(target.resize(2));
+		REQUIRE(target.capacity() == 2);
+		auto const p3 = target.claim();
+		REQUIRE(p3.value() == 8);
+		target.publish(p3);
+		REQUIRE(target.try_fetch() == p3);
+	}
+
+
+	TEST_CASE("mpsc_queue::resize after claim_for timeout") {
+		hydra::mpsc_queue<int> target(2);
+		for(auto n = 1; n != 3; ++n) {
+			auto const p = target.claim();
+			target[p] = n;
+			target.publish(p);
+		}
+		REQUIRE(!target.claim_for(std::chrono::microseconds {1}));
+		REQUIRE(target.size() == 2);
+
+		for(auto n = 1; n != 3; ++n) {
+			auto const p = target.try_fetch();
+			REQUIRE(target[p] == n);
+			target.fetched();
+		}
+
+		// Timed out claim left no sequence for resize to wait for
+		REQUIRE(target.resize(8));
+		auto const p = target.claim_for(std::chrono::microseconds {1});
+		REQUIRE(p.value() == 2);
+		target[p] = 3;
+		target.publish(p);
+		REQUIRE(target.try_fetch() == p);
+		REQUIRE(target[p] == 3);
+	}
+
+
+	TEST_CASE("mpsc_queue::resize while producing") {
+		hydra::mpsc_queue<int> target(4);
+		constexpr auto producers_count = 4;
+		constexpr auto numbers_count = 20000;
+
+		std::vector<std::future<void>> producers;
+		for(auto i = 0; i != producers_count; ++i)
+			producers.push_back(std::async(std::launch::async, [&] {
+				for(auto n = 1; n != numbers_count + 1; ++n) {
+					if(n % 100 == 0) {
+						auto const range = target.claim_n(2);
+						target[range.first()] = n;
+						target[hydra::sequence {range.first().value() + 1}] = 0;
+						target.publish_range(range);
+						continue;
+					}
+					auto const p = target.claim();
+					target[p] = n;
+					target.publish(p);
+				}
+			}));
+
+		std::int64_t sum = 0;
+		std::int64_t count = 0;
+		constexpr std::int64_t total =
+			producers_count * (numbers_count + numbers_count / 100);
+		for(std::int64_t i = 0; count != total; ++i) {
+			if(i % 1000 == 0)
+				target.resize(i % 2000 == 0 ? 64 : 4);
+			auto const p = target.try_fetch();
+			if(!p)
+				continue;
+			sum += target[p];
+			target.fetched();
+			++count;
+		}
+
+		for(auto& producer: producers)
+			producer.get();
+
+		REQUIRE(sum == std::int64_t(producers_count)
+					* (1 + numbers_count) * numbers_count / 2);
+		REQUIRE(target.resizes_count() > 0);
+	}
+
+
 }
\ No newline at end of file
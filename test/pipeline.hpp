@@ -0,0 +1,97 @@
+#pragma once
+
+
+#include <cstdint>
+#include <vector>
+
+#include "doctest.h"
+
+#include <hydra/pipeline.hpp>
+
+
+TEST_SUITE("pipeline") {
+
+
+TEST_CASE("broadcast_queue::subscribe upstreams") {
+    hydra::broadcast_queue<int> target {4};
+    auto& upstream = target.subscribe();
+    auto& downstream = target.subscribe({&upstream});
+
+    auto const n = target.claim();
+    target.publish(n);
+    REQUIRE(upstream.ready());
+    REQUIRE(!downstream.ready());
+    REQUIRE(downstream.fetch_available(4).empty());
+
+    upstream.fetched();
+    REQUIRE(downstream.try_fetch() == n);
+}
+
+
+TEST_CASE("pipeline::run") {
+    hydra::pipeline<int> target;
+    bool const started_without_stages = target.run();
+    REQUIRE(!started_without_stages);
+    target.add_stage([](auto&) {});
+    bool const started_without_buffer = target.run();
+    REQUIRE(!started_without_buffer);
+    target.reserve(16);
+    bool const started = target.run();
+    REQUIRE(started);
+    REQUIRE(target.active());
+    target.stop();
+    REQUIRE(!target.active());
+}
+
+
+TEST_CASE("pipeline::stages") {
+    struct message {
+        int raw;
+        int decoded;
+        int enriched;
+    };
+
+    hydra::pipeline<message> target;
+    target.reserve(16);
+    bool ordered = true;
+    std::int64_t persisted = 0;
+    auto const decode = target.add_stage([](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            batch[n].decoded = batch[n].raw * 2;
+            batch.fetched();
+        }
+    });
+    auto const enrich = target.add_stage(
+        [](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                batch[n].enriched = batch[n].decoded + 1;
+                batch.fetched();
+            }
+        },
+        {decode});
+    auto const persist = target.add_stage(
+        [&](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                auto const& each = batch[n];
+                ordered = ordered && each.enriched == each.raw * 2 + 1;
+                persisted += each.enriched;
+                batch.fetched();
+            }
+        },
+        {enrich});
+    target.run();
+
+    for(int i = 0; i != 1000; ++i) {
+        auto const n = target.claim();
+        target[n] = message {i, 0, 0};
+        target.publish(n);
+    }
+
+    target.stop();
+    REQUIRE(ordered);
+    REQUIRE(persisted == 1000 * 999 + 1000);
+    REQUIRE(target.messages_processed(persist) == 1000);
+}
+
+
+}
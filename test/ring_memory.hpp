@@ -0,0 +1,157 @@
+#pragma once
+
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#if defined(__linux__)
+#    include <unistd.h>
+#endif
+
+#include "doctest.h"
+
+#include <hydra/activity.hpp>
+#include <hydra/mpsc_queue.hpp>
+#include <hydra/ring_memory.hpp>
+#include <hydra/spsc_queue.hpp>
+
+
+namespace {
+
+
+    // Huge pages of the given size in kB free in hugetlbfs pool
+    long free_huge_pages(char const* size) {
+        std::ifstream file {std::string {"/sys/kernel/mm/hugepages/hugepages-"}
+                            + size + "kB/free_hugepages"};
+        long count = 0;
+        file >> count;
+        return count;
+    }
+
+
+}   // namespace
+
+
+TEST_SUITE("ring_memory") {
+
+
+TEST_CASE("ring_memory::heap") {
+    hydra::ring_memory target {1000, hydra::memory_options {}};
+    REQUIRE(!!target);
+    REQUIRE(target.mapped() == 0);
+    REQUIRE(std::uintptr_t(target.data()) % hydra::ring_memory::alignment
+            == 0);
+    target.data()[999] = std::byte {1};
+}
+
+
+TEST_CASE("ring_memory::mapped") {
+    hydra::memory_options options;
+    options.numa_node = 0;
+    options.prefault = true;
+    hydra::ring_memory target {1000, options};
+    REQUIRE(!!target);
+#if defined(__linux__)
+    REQUIRE(target.mapped() >= 1000);
+#endif
+    REQUIRE(target.data()[999] == std::byte {0});
+
+    hydra::ring_memory moved {std::move(target)};
+    REQUIRE(!target);
+    REQUIRE(!!moved);
+}
+
+
+TEST_CASE("ring_memory::huge pages") {
+    // Falls back to regular pages when no huge pages are reserved
+    hydra::memory_options options;
+    options.pages = hydra::page_size::huge_2mb;
+    hydra::ring_memory target {1000, options};
+    REQUIRE(!!target);
+#if defined(__linux__)
+    if(free_huge_pages("2048") == 0)
+        REQUIRE(target.mapped() == std::size_t(sysconf(_SC_PAGESIZE)));
+    else
+        REQUIRE(target.mapped() == std::size_t(1) << 21);
+#endif
+    target.data()[target.mapped() == 0 ? 999 : target.mapped() - 1] =
+        std::byte {1};
+}
+
+
+TEST_CASE("ring_memory::huge page fallback") {
+    // Without 1 GB pages reserved the ring is not rounded up to 1 GB
+    constexpr auto bytes = std::size_t(16) << 20;
+    hydra::memory_options options;
+    options.pages = hydra::page_size::huge_1gb;
+    options.prefault = true;
+    hydra::ring_memory target {bytes, options};
+    REQUIRE(!!target);
+#if defined(__linux__)
+    if(free_huge_pages("1048576") == 0)
+        REQUIRE(target.mapped() == bytes);
+#endif
+    REQUIRE(target.data()[bytes - 1] == std::byte {0});
+}
+
+
+TEST_CASE_TEMPLATE("ring_memory::queue",
+                   Q,
+                   hydra::spsc_queue<std::int64_t>,
+                   hydra::mpsc_queue<std::int64_t>) {
+    hydra::memory_options options;
+    options.pages = hydra::page_size::huge_2mb;
+    options.prefault = true;
+    Q target;
+    target.reserve(1 << 10, options);
+    REQUIRE(target.capacity() == 1 << 10);
+
+    for(std::int64_t i = 0; i != 2000; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+        auto const f = target.try_fetch();
+        REQUIRE(target[f] == i);
+        target.fetched();
+    }
+}
+
+
+TEST_CASE("ring_memory::resize keeps options") {
+    hydra::memory_options options;
+    options.numa_node = 0;
+    hydra::mpsc_queue<std::int64_t> target;
+    target.reserve(2, options);
+    auto const n = target.claim();
+    target[n] = 42;
+    target.publish(n);
+    REQUIRE(target.resize(64));
+    REQUIRE(target[target.try_fetch()] == 42);
+    target.fetched();
+}
+
+
+TEST_CASE("ring_memory::activity") {
+    hydra::memory_options options;
+    options.prefault = true;
+    hydra::activity<std::int64_t> target;
+    target.reserve(64, options);
+    std::atomic<std::int64_t> sum {0};
+    target.run([&sum](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            sum += batch[n];
+            batch.fetched();
+        }
+    });
+    for(std::int64_t i = 1; i <= 100; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+    target.stop();
+    REQUIRE(sum == 5050);
+}
+
+
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+
+#if defined(__linux__)
+
+
+#include <cstdint>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "doctest.h"
+
+#include <hydra/shared_queue.hpp>
+
+
+namespace {
+
+
+    std::string shared_queue_name(char const* suffix) {
+        return "/hydra-test-" + std::to_string(getpid()) + "-" + suffix;
+    }
+
+
+}   // namespace
+
+
+TEST_SUITE("shared_queue") {
+
+
+TEST_CASE("shared_queue::create and attach") {
+    auto const name = shared_queue_name("named");
+    auto producer =
+        hydra::shared_spsc_queue<std::int64_t>::create(name.data(), 5);
+    REQUIRE(!!producer);
+    REQUIRE(producer.capacity() == 8);
+    REQUIRE(!hydra::shared_spsc_queue<std::int64_t>::create(name.data(), 8));
+
+    auto consumer = hydra::shared_spsc_queue<std::int64_t>::attach(name.data());
+    REQUIRE(!!consumer);
+    REQUIRE(consumer.capacity() == 8);
+    REQUIRE(hydra::shared_spsc_queue<std::int64_t>::remove(name.data()));
+
+    for(std::int64_t i = 0; i != 20; ++i) {
+        auto const n = producer.claim();
+        producer[n] = i;
+        producer.publish(n);
+        REQUIRE(consumer.size() == 1);
+        auto const f = consumer.try_fetch();
+        REQUIRE(!!f);
+        REQUIRE(consumer[f] == i);
+        consumer.fetched();
+    }
+    REQUIRE(!consumer.try_fetch());
+}
+
+
+TEST_CASE("shared_queue::attach mismatch") {
+    auto const name = shared_queue_name("mismatch");
+    REQUIRE(!hydra::shared_spsc_queue<std::int64_t>::attach(name.data()));
+
+    auto const created =
+        hydra::shared_spsc_queue<std::int64_t>::create(name.data(), 8);
+    REQUIRE(!!created);
+    REQUIRE(!hydra::shared_spsc_queue<std::int32_t>::attach(name.data()));
+    REQUIRE(!hydra::shared_mpsc_queue<std::int64_t>::attach(name.data()));
+    hydra::shared_spsc_queue<std::int64_t>::remove(name.data());
+}
+
+
+TEST_CASE("shared_queue::corrupt layout") {
+    using queue = hydra::shared_spsc_queue<std::int64_t>;
+    auto const created = queue::create_anonymous(8);
+    REQUIRE(!!created);
+    auto* const header = static_cast<hydra::shared_queue_header*>(
+        mmap(nullptr,
+             sizeof(hydra::shared_queue_header),
+             PROT_READ | PROT_WRITE,
+             MAP_SHARED,
+             created.fd(),
+             0));
+    REQUIRE(header != MAP_FAILED);
+    auto const capacity = header->capacity;
+    auto const stamps_offset = header->stamps_offset;
+    auto const messages_offset = header->messages_offset;
+    auto const region_size = header->region_size;
+    REQUIRE(!!queue::attach(created.fd()));
+
+    header->capacity = 6;
+    REQUIRE(!queue::attach(created.fd()));
+    header->capacity = std::uint64_t(1) << 40;
+    REQUIRE(!queue::attach(created.fd()));
+    header->capacity = capacity;
+
+    header->messages_offset = messages_offset + 8;
+    REQUIRE(!queue::attach(created.fd()));
+    header->messages_offset = region_size;
+    REQUIRE(!queue::attach(created.fd()));
+    header->messages_offset = messages_offset;
+
+    header->stamps_offset = messages_offset;
+    REQUIRE(!queue::attach(created.fd()));
+    header->stamps_offset = stamps_offset;
+
+    REQUIRE(!!queue::attach(created.fd()));
+    munmap(header, sizeof(hydra::shared_queue_header));
+}
+
+
+TEST_CASE("shared_queue::two processes") {
+    constexpr std::int64_t count = 10000;
+    using queue = hydra::shared_mpsc_queue<std::int64_t>;
+    auto consumer = queue::create_anonymous(16);
+    REQUIRE(!!consumer);
+
+    auto const child = fork();
+    REQUIRE(child != -1);
+    if(child == 0) {
+        auto producer = queue::attach(consumer.fd());
+        if(!producer)
+            _exit(1);
+        for(std::int64_t i = 0; i != count; ++i) {
+            auto const n = producer.claim();
+            producer[n] = i;
+            producer.publish(n);
+        }
+        _exit(0);
+    }
+
+    std::int64_t sum = 0;
+    for(std::int64_t i = 0; i != count; ++i) {
+        auto const n = consumer.fetch();
+        sum += consumer[n];
+        consumer.fetched();
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    REQUIRE(WIFEXITED(status));
+    REQUIRE(WEXITSTATUS(status) == 0);
+    REQUIRE(sum == count * (count - 1) / 2);
+}
+
+
+}
+
+
+#endif
@@ -0,0 +1,250 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "doctest.h"
+
+#include <hydra/activity.hpp>
+#include <hydra/mpsc_queue.hpp>
+#include <hydra/slot_storage.hpp>
+#include <hydra/spsc_queue.hpp>
+
+
+namespace {
+
+
+    // Neither default constructible nor copyable, counts live instances
+    struct tracked_message {
+        static inline std::atomic<int> alive = 0;
+
+        std::unique_ptr<std::string> text;
+
+        explicit tracked_message(char const* s)
+            : text {std::make_unique<std::string>(s)} {
+            ++alive;
+        }
+
+        tracked_message(tracked_message&& other) noexcept
+            : text {std::move(other.text)} {
+            ++alive;
+        }
+
+        ~tracked_message() { --alive; }
+    };   // tracked_message
+
+
+    using per_message_slots =
+        hydra::separate_slots<tracked_message,
+                              hydra::slot_lifetime::per_message>;
+
+
+    using interleaved_per_message_slots =
+        hydra::interleaved_slots<tracked_message,
+                                 hydra::slot_lifetime::per_message>;
+
+
+}   // namespace
+
+
+TEST_SUITE("slot_storage") {
+
+
+TEST_CASE_TEMPLATE("slot_storage::per_message",
+                   Q,
+                   hydra::spsc_queue<tracked_message,
+                                     hydra::cacheline_size,
+                                     per_message_slots>,
+                   hydra::mpsc_queue<tracked_message,
+                                     hydra::cacheline_size,
+                                     per_message_slots>) {
+    {
+        Q target;
+        target.reserve(4);
+        REQUIRE(tracked_message::alive == 0);
+
+        target.emplace("first");
+        auto const n = target.claim();
+        target.construct(n, "second");
+        target.publish(n);
+        REQUIRE(tracked_message::alive == 2);
+
+        auto const f = target.try_fetch();
+        REQUIRE(*target[f].text == "first");
+        target.fetched();
+        REQUIRE(tracked_message::alive == 1);
+
+        target.emplace("third");
+        auto const messages = target.fetch_available(4);
+        REQUIRE(messages.size() == 2);
+        REQUIRE(*messages[1].text == "third");
+        target.fetched(std::int64_t(messages.size()));
+        REQUIRE(tracked_message::alive == 0);
+
+        target.emplace("left in queue");
+        REQUIRE(tracked_message::alive == 1);
+    }
+    REQUIRE(tracked_message::alive == 0);
+}
+
+
+TEST_CASE("slot_storage::resize") {
+    hydra::mpsc_queue<tracked_message,
+                      hydra::cacheline_size,
+                      per_message_slots>
+        target;
+    target.reserve(2);
+    target.emplace("first");
+    target.emplace("second");
+    REQUIRE(target.resize(8));
+    REQUIRE(tracked_message::alive == 2);
+    REQUIRE(*target[target.try_fetch()].text == "first");
+    target.fetched();
+    REQUIRE(*target[target.try_fetch()].text == "second");
+    target.fetched();
+    REQUIRE(tracked_message::alive == 0);
+}
+
+
+TEST_CASE("slot_storage::activity") {
+    {
+        hydra::activity<tracked_message,
+                        hydra::mpsc_queue<tracked_message,
+                                          hydra::cacheline_size,
+                                          per_message_slots>>
+            target;
+        target.reserve(4);
+        std::atomic<int> received {0};
+        target.run([&received](auto& batch) {
+            for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+                received += batch[n].text->empty() ? 0 : 1;
+                batch.fetched();
+            }
+        });
+
+        for(int i = 0; i != 100; ++i)
+            target.emplace("message");
+
+        target.stop();
+        REQUIRE(received == 100);
+    }
+    REQUIRE(tracked_message::alive == 0);
+}
+
+
+TEST_CASE_TEMPLATE("slot_storage::interleaved",
+                   Q,
+                   hydra::spsc_queue<std::int64_t,
+                                     hydra::cacheline_size,
+                                     hydra::interleaved_slots<std::int64_t>>,
+                   hydra::mpsc_queue<std::int64_t,
+                                     hydra::cacheline_size,
+                                     hydra::interleaved_slots<std::int64_t>>) {
+    Q target;
+    target.reserve(4);
+    REQUIRE(!target.try_fetch());
+
+    for(std::int64_t i = 0; i != 10; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+        auto const f = target.try_fetch();
+        REQUIRE(!!f);
+        REQUIRE(target[f] == i);
+        target.fetched();
+    }
+
+    std::int64_t const in[] = {1, 2, 3};
+    REQUIRE(target.push_bulk(in, 3));
+    std::int64_t out[4] = {};
+    REQUIRE(target.try_pop_bulk(out, 4) == 3);
+    REQUIRE(out[0] == 1);
+    REQUIRE(out[2] == 3);
+    REQUIRE(target.try_pop_bulk(out, 4) == 0);
+}
+
+
+TEST_CASE("slot_storage::interleaved layout") {
+    struct pair {
+        std::int64_t first;
+        std::int64_t second;
+    };
+    using slots = hydra::interleaved_slots<pair>;
+    static_assert(slots::stamps_per_line == 2);
+
+    slots target;
+    target.reserve(8);
+    // Whole slot lies on the line of its stamp
+    for(auto i = 0; i != 8; ++i) {
+        auto const first = std::uintptr_t(&target.stamp(i));
+        auto const last = std::uintptr_t(&target.value(i)) + sizeof(pair) - 1;
+        REQUIRE(first % 32 == 0);
+        REQUIRE(first / hydra::cacheline_size
+                == last / hydra::cacheline_size);
+    }
+
+    static_assert(hydra::interleaved_slots<std::int64_t>::stamps_per_line
+                  == 4);
+    struct large {
+        char bytes[100];
+    };
+    static_assert(hydra::interleaved_slots<large>::stamps_per_line == 1);
+}
+
+
+TEST_CASE("slot_storage::interleaved concurrently") {
+    hydra::spsc_queue<std::int64_t,
+                      hydra::cacheline_size,
+                      hydra::interleaved_slots<std::int64_t>>
+        target;
+    target.reserve(16);
+    constexpr std::int64_t count = 100000;
+
+    std::thread producer {[&target] {
+        for(std::int64_t i = 0; i != count; ++i) {
+            auto const n = target.claim();
+            target[n] = i;
+            target.publish(n);
+        }
+    }};
+
+    std::int64_t expected = 0;
+    bool ordered = true;
+    while(expected != count) {
+        auto const n = target.try_fetch();
+        if(!n)
+            continue;
+        ordered = ordered && target[n] == expected;
+        target.fetched();
+        ++expected;
+    }
+    producer.join();
+    REQUIRE(ordered);
+}
+
+
+TEST_CASE("slot_storage::interleaved per_message") {
+    {
+        hydra::mpsc_queue<tracked_message,
+                          hydra::cacheline_size,
+                          interleaved_per_message_slots>
+            target;
+        target.reserve(2);
+        target.emplace("first");
+        target.emplace("second");
+        REQUIRE(target.resize(8));
+        REQUIRE(*target[target.try_fetch()].text == "first");
+        target.fetched();
+        REQUIRE(tracked_message::alive == 1);
+        target.emplace("left in queue");
+        REQUIRE(tracked_message::alive == 2);
+    }
+    REQUIRE(tracked_message::alive == 0);
+}
+
+
+}
@@ -1,6 +1,11 @@
 #pragma once
 
 
+#include <chrono>
+#include <future>
+#include <thread>
+#include <vector>
+
 #include "doctest.h"
 
 #include <hydra/spsc_queue.hpp>
@@ -14,5 +19,132 @@ TEST_SUITE("spsc_queue") {
 		REQUIRE(!target);
 		REQUIRE(target.size() == 0);
 	}
+
+
+	TEST_CASE("spsc_queue::layout") {
+		REQUIRE(alignof(hydra::spsc_queue<int>) == hydra::cacheline_size);
+		REQUIRE(sizeof(hydra::spsc_queue<int>) == 4 * hydra::cacheline_size);
+		REQUIRE(alignof(hydra::spsc_queue<int, hydra::cacheline_pair_size>)
+				== hydra::cacheline_pair_size);
+		REQUIRE(alignof(hydra::spsc_queue<int, hydra::packed_layout>)
+				== hydra::packed_layout);
+	}
+
+
+	TEST_CASE("spsc_queue::multithreading") {
+		hydra::spsc_queue<int> target;
+		target.reserve(4);
+		constexpr auto from_number = 1;
+		constexpr auto to_number = 1000;
+		constexpr auto numbers_count = to_number - from_number + 1;
+
+		auto summator = std::async(std::launch::async, [&] {
+			auto count = 0, sum = 0;
+			while(count != numbers_count) {
+				auto const p = target.try_fetch();
+				if(!p)
+					continue;
+				sum += target[p];
+				target.fetched();
+				++count;
+			}
+			return sum;
+		});
+
+		for(auto n = from_number; n != to_number + 1; ++n) {
+			auto const p = target.claim();
+			target[p] = n;
+			target.publish(p);
+		}
+
+		REQUIRE(summator.get() == (from_number + to_number) * numbers_count / 2);
+	}
+
+
+	TEST_CASE("spsc_queue::push_bulk") {
+		hydra::spsc_queue<int> target;
+		target.reserve(8);
+		int const in[] = {1, 2, 3, 4, 5, 6};
+		int out[8] = {};
+
+		REQUIRE(target.push_bulk(in, 6));
+		REQUIRE(target.try_pop_bulk(out, 4) == 4);
+		REQUIRE(out[3] == 4);
+
+		// Wraps around the end of the ring
+		REQUIRE(target.push_bulk(in, 6));
+		REQUIRE(target.size() == 8);
+		REQUIRE(target.try_pop_bulk(out, 8) == 8);
+		REQUIRE(out[0] == 5);
+		REQUIRE(out[1] == 6);
+		REQUIRE(out[2] == 1);
+		REQUIRE(out[7] == 6);
+		REQUIRE(target.try_pop_bulk(out, 8) == 0);
+	}
+
+
+	TEST_CASE("spsc_queue::push_bulk beyond capacity") {
+		hydra::spsc_queue<int> target;
+		target.reserve(4);
+		constexpr int count = 1000;
+		std::vector<int> in(count);
+		for(int i = 0; i != count; ++i)
+			in[std::size_t(i)] = i + 1;
+
+		auto summator = std::async(std::launch::async, [&] {
+			int sum = 0, received = 0, out[3];
+			while(received != count) {
+				auto const popped = target.try_pop_bulk(out, 3);
+				for(std::int64_t i = 0; i != popped; ++i)
+					sum += out[i];
+				received += int(popped);
+			}
+			return sum;
+		});
+
+		REQUIRE(target.push_bulk(in.data(), count));
+		REQUIRE(summator.get() == count * (count + 1) / 2);
+	}
+
+
+	TEST_CASE("spsc_queue::park_producers") {
+		hydra::spsc_queue<int> target;
+		target.reserve(2);
+		target.park_producers(1);
+		for(auto n = 1; n != 3; ++n) {
+			auto const p = target.claim();
+			target[p] = n;
+			target.publish(p);
+		}
+
+		// Default yielding_wait parks as well
+		auto producer = std::async(std::launch::async, [&] {
+			auto const p = target.claim();
+			target[p] = 3;
+			target.publish(p);
+		});
+
+		auto const deadline =
+			std::chrono::steady_clock::now() + std::chrono::seconds {5};
+		while(target.parked_producers() == 0
+			  && std::chrono::steady_clock::now() < deadline)
+			std::this_thread::yield();
+		REQUIRE(target.parked_producers() == 1);
+
+		auto sum = 0;
+		while(sum != 6) {
+			auto const p = target.try_fetch();
+			if(!p) {
+				std::this_thread::yield();
+				continue;
+			}
+			sum += target[p];
+			target.fetched();
+		}
+		producer.get();
+		REQUIRE(target.parked_producers() == 0);
+		REQUIRE(target.blocks_count() == 1);
+	}
+
 	
 }
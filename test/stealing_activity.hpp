@@ -0,0 +1,111 @@
+#pragma once
+
+
+#include <atomic>
+#include <thread>
+
+#include "doctest.h"
+
+#include <hydra/stealing_activity.hpp>
+
+
+TEST_SUITE("stealing_activity") {
+
+
+TEST_CASE("stealing_activity::stealing_activity") {
+    hydra::stealing_activity<int> target {4};
+    REQUIRE(!target.active());
+    REQUIRE(target.shards_count() == 4);
+    REQUIRE(target.steals_count() == 0);
+}
+
+
+TEST_CASE("stealing_activity::run") {
+    hydra::stealing_activity<int> target {2};
+    bool const started_without_buffer = target.run([](auto&) {});
+    REQUIRE(!started_without_buffer);
+    target.reserve(16);
+    bool const started_with_buffer = target.run([](auto&) {});
+    REQUIRE(started_with_buffer);
+    bool const started_already_active = target.run([](auto&) {});
+    REQUIRE(!started_already_active);
+    target.stop();
+    REQUIRE(!target.active());
+}
+
+
+TEST_CASE("stealing_activity::skewed") {
+    hydra::stealing_activity<int> target {4};
+    target.reserve(64);
+    std::atomic<int> sum {0};
+    target.run([&sum](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            sum += batch[n];
+            batch.fetched();
+        }
+    });
+
+    auto& hot = target.shard(0);
+    for(int i = 1; i != 1001; ++i) {
+        auto const n = hot.claim();
+        hot[n] = i;
+        hot.publish(n);
+    }
+
+    auto& cold = target.shard(3);
+    auto const range = cold.claim_n(10);
+    for(auto n: range)
+        cold[n] = 1;
+    cold.publish_range(range);
+
+    target.stop();
+    REQUIRE(sum == 500510);
+}
+
+
+TEST_CASE("stealing_activity::steal from blocked worker") {
+    constexpr int blocker = -1;
+    hydra::stealing_activity<int> target {2};
+    target.reserve(64);
+    std::atomic<bool> blocked {false};
+    std::atomic<bool> released {false};
+    std::atomic<int> handled {0};
+    target.run([&](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            if(batch[n] == blocker) {
+                blocked = true;
+                while(!released)
+                    std::this_thread::yield();
+            } else {
+                ++handled;
+            }
+            batch.fetched();
+        }
+    });
+
+    auto const publish = [&target](std::size_t shard, int value) {
+        auto const n = target.shard(shard).claim();
+        target.shard(shard)[n] = value;
+        target.shard(shard).publish(n);
+    };
+
+    publish(0, blocker);
+    while(!blocked)
+        std::this_thread::yield();
+
+    // Whichever worker is held, messages of its own shard are
+    // reachable for the other one only by stealing
+    for(int i = 0; i != 10; ++i) {
+        publish(0, i);
+        publish(1, i);
+    }
+    while(handled != 20)
+        std::this_thread::yield();
+    REQUIRE(target.steals_count() > 0);
+
+    released = true;
+    target.stop();
+}
+
+
+}
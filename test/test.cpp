@@ -3,6 +3,19 @@
 
 
 #include "activity.hpp"
+#include "activity_pool.hpp"
+#include "broadcast_queue.hpp"
+#include "byte_queue.hpp"
 #include "futex_event.hpp"
+#include "journal_queue.hpp"
+#include "metrics.hpp"
+#include "mpmc_queue.hpp"
 #include "mpsc_queue.hpp"
+#include "pipeline.hpp"
+#include "ring_memory.hpp"
+#include "shared_queue.hpp"
+#include "slot_storage.hpp"
 #include "spsc_queue.hpp"
+#include "stealing_activity.hpp"
+#include "unbounded_mpsc_queue.hpp"
+#include "wait_strategy.hpp"
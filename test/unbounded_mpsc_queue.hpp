@@ -0,0 +1,161 @@
+#pragma once
+
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "doctest.h"
+
+#include <hydra/activity.hpp>
+#include <hydra/unbounded_mpsc_queue.hpp>
+
+
+TEST_SUITE("unbounded_mpsc_queue") {
+
+
+TEST_CASE("unbounded_mpsc_queue::unbounded_mpsc_queue") {
+    hydra::unbounded_mpsc_queue<int> target;
+    REQUIRE(!target);
+    REQUIRE(!target.claim());
+    REQUIRE(target.size() == 0);
+}
+
+
+TEST_CASE("unbounded_mpsc_queue::claim") {
+    hydra::unbounded_mpsc_queue<int, 4> target {4};
+    for(int i = 0; i != 10; ++i) {
+        auto const n = target.claim();
+        REQUIRE(n.value() == i);
+        target[n] = i;
+        target.publish(n);
+    }
+    REQUIRE(target.size() == 10);
+    REQUIRE(target.segments_count() == 3);
+
+    for(int i = 0; i != 10; ++i) {
+        auto const n = target.try_fetch();
+        REQUIRE(!!n);
+        REQUIRE(target[n] == i);
+        target.fetched();
+    }
+    REQUIRE(!target.try_fetch());
+}
+
+
+TEST_CASE("unbounded_mpsc_queue::recycling") {
+    hydra::unbounded_mpsc_queue<int, 4> target {8};
+    REQUIRE(target.segments_count() == 2);
+    for(int round = 0; round != 100; ++round) {
+        auto const range = target.claim_n(6);
+        for(auto n: range)
+            target[n] = 1;
+        target.publish_range(range);
+
+        int sum = 0;
+        for(auto messages = target.fetch_available(8); !messages.empty();
+            messages = target.fetch_available(8)) {
+            for(std::size_t i = 0; i != messages.size(); ++i)
+                sum += messages[i];
+            target.fetched(std::int64_t(messages.size()));
+        }
+        REQUIRE(sum == 6);
+    }
+    REQUIRE(target.segments_count() <= 4);
+}
+
+
+TEST_CASE("unbounded_mpsc_queue::recycling range published by element") {
+    hydra::unbounded_mpsc_queue<int, 4> target {8};
+    for(int round = 0; round != 100; ++round) {
+        auto const range = target.claim_n(3);
+        for(auto n: range) {
+            target[n] = 1;
+            target.publish(n);
+        }
+
+        int sum = 0;
+        for(auto n = target.try_fetch(); !!n; n = target.try_fetch()) {
+            sum += target[n];
+            target.fetched();
+        }
+        REQUIRE(sum == 3);
+    }
+    REQUIRE(target.segments_count() <= 4);
+}
+
+
+TEST_CASE("unbounded_mpsc_queue::recycling with claims in flight") {
+    // There is always a claimed and not yet published message
+    hydra::unbounded_mpsc_queue<int, 4> target {8};
+    auto pending = target.claim();
+    int sum = 0;
+    for(int i = 0; i != 100; ++i) {
+        auto const next = target.claim();
+        target[pending] = 1;
+        target.publish(pending);
+        pending = next;
+        for(auto n = target.try_fetch(); !!n; n = target.try_fetch()) {
+            sum += target[n];
+            target.fetched();
+        }
+    }
+    REQUIRE(sum == 100);
+    REQUIRE(target.segments_count() <= 4);
+}
+
+
+TEST_CASE("unbounded_mpsc_queue::multithreading") {
+    constexpr std::int64_t per_producer = 20000;
+    hydra::unbounded_mpsc_queue<std::int64_t, 64> target {64};
+    std::vector<std::thread> producers;
+    for(int i = 0; i != 4; ++i)
+        producers.emplace_back([&target] {
+            for(std::int64_t j = 1; j <= per_producer; ++j) {
+                auto const n = target.claim();
+                target[n] = j;
+                target.publish(n);
+            }
+        });
+
+    std::int64_t sum = 0;
+    for(std::int64_t received = 0; received != 4 * per_producer;) {
+        auto const n = target.try_fetch();
+        if(!n)
+            continue;
+        sum += target[n];
+        target.fetched();
+        ++received;
+    }
+
+    for(auto& producer: producers)
+        producer.join();
+
+    REQUIRE(sum == 4 * per_producer * (per_producer + 1) / 2);
+}
+
+
+TEST_CASE("unbounded_mpsc_queue::activity") {
+    hydra::activity<int, hydra::unbounded_mpsc_queue<int, 16>> target;
+    target.reserve(16);
+    std::atomic<int> sum {0};
+    target.run([&sum](auto& batch) {
+        for(auto n = batch.try_fetch(); !!n; n = batch.try_fetch()) {
+            sum += batch[n];
+            batch.fetched();
+        }
+    });
+
+    for(int i = 1; i != 1001; ++i) {
+        auto const n = target.claim();
+        target[n] = i;
+        target.publish(n);
+    }
+
+    target.stop();
+    REQUIRE(sum == 500500);
+}
+
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+
+#include <atomic>
+#include <future>
+
+#include "doctest.h"
+
+#include <hydra/wait_strategy.hpp>
+
+
+TEST_SUITE("wait_strategy") {
+
+
+	TEST_CASE_TEMPLATE("wait_strategy::wait_until(ready)", W,
+					   hydra::busy_spin_wait,
+					   hydra::yielding_wait,
+					   hydra::sleeping_wait,
+					   hydra::blocking_wait,
+					   hydra::adaptive_wait) {
+		std::atomic<bool> ready {false};
+		auto waiter = std::async(std::launch::async, [&] {
+			W {}.wait_until([&] { return ready.load(); });
+			return true;
+		});
+		ready = true;
+		REQUIRE(waiter.get());
+	}
+
+
+	TEST_CASE_TEMPLATE("wait_strategy::wait_until(event, ready)", W,
+					   hydra::busy_spin_wait,
+					   hydra::yielding_wait,
+					   hydra::sleeping_wait,
+					   hydra::blocking_wait,
+					   hydra::adaptive_wait) {
+		hydra::futex_event event;
+		std::atomic<int> counter {0};
+		constexpr auto count = 1000;
+		auto waiter = std::async(std::launch::async, [&] {
+			for(auto i = 1; i != count + 1; ++i)
+				W {}.wait_until(event, [&] { return counter.load() >= i; });
+			return counter.load();
+		});
+		for(auto i = 0; i != count; ++i) {
+			counter.fetch_add(1);
+			event.notify_one();
+		}
+		REQUIRE(waiter.get() == count);
+	}
+
+
+}